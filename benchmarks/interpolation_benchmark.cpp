@@ -0,0 +1,75 @@
+// Cost of the varispeed interpolation kernels per mode and speed, for one channel.
+// Build with -DMINILOOPER_BUILD_BENCHMARKS=ON in a Release configuration.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "looper/interpolation.h"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr unsigned int SAMPLE_RATE = 48000;
+static constexpr unsigned int SECONDS = 10;
+static constexpr unsigned int BLOCK_FRAMES = 256;
+
+// noise keeps the compiler from folding anything and exercises every phase
+static std::vector<float> makeSource(unsigned int numFrames)
+{
+    std::vector<float> source(numFrames);
+    unsigned int seed = 1;
+    for (auto& sample : source) {
+        seed = seed * 1664525u + 1013904223u;
+        sample = static_cast<float>(seed >> 8) / 8388608.0f - 1.0f;
+    }
+    return source;
+}
+
+// Plays SECONDS of output at speed from a source long enough to never wrap, block by block as
+// the looper does. The looper's gather into a contiguous run is not included.
+static void benchmark(looper::Interpolation mode, double speed)
+{
+    constexpr auto margin = looper::INTERPOLATION_MARGIN;
+    const auto outFrames = SAMPLE_RATE * SECONDS;
+    const auto span = static_cast<unsigned int>(std::ceil(outFrames * std::abs(speed)));
+    const auto source = makeSource(span + 2 * margin + 2);
+
+    std::vector<float> out(BLOCK_FRAMES);
+    auto position = speed < 0.0 ? static_cast<double>(span + margin) : static_cast<double>(margin);
+    auto checksum = 0.0f;
+    const auto start = Clock::now();
+
+    for (auto done{0u}; done < outFrames; done += BLOCK_FRAMES) {
+        std::fill(out.begin(), out.end(), 0.0f);
+        looper::interpolate(mode, source.data(), position, speed, out.data(), BLOCK_FRAMES);
+        position += BLOCK_FRAMES * speed;
+        checksum += out[BLOCK_FRAMES - 1];
+    }
+
+    const auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const auto nsPerFrame = seconds * 1e9 / outFrames;
+    std::printf("%-6s  speed %5.2f  %6.2f ns/frame  %8.1fx realtime  %6.3f%% of a core  (%g)\n",
+                looper::interpolationToStr(mode), speed, nsPerFrame, SECONDS / seconds,
+                100.0 * seconds / SECONDS, static_cast<double>(checksum));
+}
+
+int main()
+{
+    constexpr looper::Interpolation modes[] = {
+        looper::Interpolation::LINEAR,
+        looper::Interpolation::CUBIC,
+        looper::Interpolation::SINC,
+    };
+    constexpr double speeds[] = {0.5, 0.7937, 1.5, 2.0, -1.0, 4.0};
+
+    std::printf("%u Hz, %u s of output per run, %u frame blocks, costs per channel\n", SAMPLE_RATE, SECONDS,
+                BLOCK_FRAMES);
+    for (const auto mode : modes) {
+        for (const auto speed : speeds)
+            benchmark(mode, speed);
+    }
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Throughput of fx::Resampler per quality level, streaming and offline.
+// Build with -DMINILOOPER_BUILD_BENCHMARKS=ON in a Release configuration.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "fx/resampler.h"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr unsigned int NUM_CHANNELS = 2;
+static constexpr unsigned int SECONDS = 10;
+static constexpr unsigned int BLOCK_FRAMES = 256;
+
+static const char* qualityName(fx::Resampler::Quality quality)
+{
+    switch (quality) {
+        case fx::Resampler::Quality::DRAFT: return "draft";
+        case fx::Resampler::Quality::NORMAL: return "normal";
+        case fx::Resampler::Quality::HIGH: return "high";
+        case fx::Resampler::Quality::BEST: return "best";
+    }
+    return "?";
+}
+
+// noise keeps the compiler from folding anything and exercises every phase
+static std::vector<std::vector<float>> makeInput(unsigned int numFrames)
+{
+    std::vector<std::vector<float>> channels(NUM_CHANNELS, std::vector<float>(numFrames));
+    unsigned int seed = 1;
+    for (auto& channel : channels) {
+        for (auto& sample : channel) {
+            seed = seed * 1664525u + 1013904223u;
+            sample = static_cast<float>(seed >> 8) / 8388608.0f - 1.0f;
+        }
+    }
+    return channels;
+}
+
+static void report(const char* mode, fx::Resampler::Quality quality, unsigned int fromRate, unsigned int toRate,
+                   unsigned int taps, unsigned long long outFrames, double seconds, float checksum)
+{
+    const auto framesPerSecond = static_cast<double>(outFrames) / seconds;
+    std::printf("%-9s %-7s %6u -> %6u  taps %4u  %8.2f Mframes/s  %7.1fx realtime  (%g)\n",
+                mode, qualityName(quality), fromRate, toRate, taps, framesPerSecond * 1e-6,
+                framesPerSecond / toRate, static_cast<double>(checksum));
+}
+
+static void benchmarkStreaming(fx::Resampler::Quality quality, unsigned int fromRate, unsigned int toRate)
+{
+    const auto input = makeInput(fromRate * SECONDS);
+    const auto numFrames = static_cast<unsigned int>(input.front().size());
+
+    fx::Resampler resampler;
+    resampler.prepare(NUM_CHANNELS, static_cast<double>(toRate) / fromRate, quality);
+
+    std::vector<std::vector<float>> output(NUM_CHANNELS, std::vector<float>(4 * BLOCK_FRAMES));
+    const float* in[NUM_CHANNELS];
+    float* out[NUM_CHANNELS];
+    for (auto c{0u}; c < NUM_CHANNELS; ++c) out[c] = output[c].data();
+
+    unsigned long long produced = 0;
+    auto checksum = 0.0f;
+    const auto start = Clock::now();
+
+    for (auto position{0u}; position < numFrames;) {
+        for (auto c{0u}; c < NUM_CHANNELS; ++c) in[c] = input[c].data() + position;
+        unsigned int consumed = 0;
+        const auto n = resampler.process(in, std::min(BLOCK_FRAMES, numFrames - position), out, 4 * BLOCK_FRAMES, consumed);
+        if (n > 0) checksum += out[0][n - 1];
+        produced += n;
+        position += consumed;
+    }
+
+    const auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report("streaming", quality, fromRate, toRate, resampler.getNumTaps(), produced, seconds, checksum);
+}
+
+static void benchmarkOffline(fx::Resampler::Quality quality, unsigned int fromRate, unsigned int toRate)
+{
+    const auto input = makeInput(fromRate * SECONDS);
+
+    fx::Resampler resampler;
+    resampler.prepare(1, static_cast<double>(toRate) / fromRate, quality);
+
+    const auto start = Clock::now();
+    const auto output = fx::resample(input, fromRate, toRate, quality);
+    const auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    report("offline", quality, fromRate, toRate, resampler.getNumTaps(), output.front().size(), seconds,
+           output.front().back());
+}
+
+int main()
+{
+    constexpr fx::Resampler::Quality qualities[] = {
+        fx::Resampler::Quality::DRAFT,
+        fx::Resampler::Quality::NORMAL,
+        fx::Resampler::Quality::HIGH,
+        fx::Resampler::Quality::BEST,
+    };
+    constexpr unsigned int conversions[][2] = {
+        {48000, 44100},
+        {44100, 48000},
+        {48000, 96000},
+        {96000, 48000},
+    };
+
+    std::printf("%u channels, %u s of input per run, frames counted per channel\n", NUM_CHANNELS, SECONDS);
+    for (const auto quality : qualities) {
+        for (const auto& [fromRate, toRate] : conversions)
+            benchmarkStreaming(quality, fromRate, toRate);
+        for (const auto& [fromRate, toRate] : conversions)
+            benchmarkOffline(quality, fromRate, toRate);
+    }
+
+    return 0;
+}
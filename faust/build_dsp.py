@@ -1,5 +1,8 @@
 #!/usr/bin/env python3
 
+# Regenerates the checked-in headers used when the faust compiler is not available to CMake.
+# Extra arguments are passed to faust, e.g. ./build_dsp.py -vec -vs 32 -ftz 2
+
 import subprocess
 from pathlib import Path
 import sys
@@ -32,6 +35,7 @@ for dsp_path in DSP_DIR.glob("*.dsp"):
         "faust",
         "-i",
         "-a", str(ARCH_FILE),
+        *sys.argv[1:],
         str(dsp_path),
         "-o", str(out_path)
     ])
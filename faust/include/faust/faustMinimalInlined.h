@@ -1,5 +1,5 @@
-#ifndef  __mydsp_H__
-#define  __mydsp_H__
+#ifndef FAUST_MINIMAL_INLINED_H
+#define FAUST_MINIMAL_INLINED_H
 
 #include <cmath>
 #include <cstring>
@@ -7,8 +7,8 @@ Compilation options: -a /home/dmitrik/dev/looper_cpp_mark_ii/faust/include/faust
 #ifndef  __mydsp_H__
 #define  __mydsp_H__
 
-#ifndef  __mydsp_H__
-#define  __mydsp_H__
+#ifndef FAUST_MINIMAL_INLINED_H
+#define FAUST_MINIMAL_INLINED_H
 
 #include <cmath>
 #include <cstring>
@@ -0,0 +1,164 @@
+#include "async_input.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "audio_engine.h"
+
+using namespace audio;
+
+void AsyncInput::prepare(unsigned int numChannels, double inputRate, double outputRate,
+                         unsigned int inputBufferSize, unsigned int outputBufferSize)
+{
+    numChannels_ = numChannels;
+    inputRate_ = inputRate;
+    outputRate_ = outputRate;
+    nominalRatio_ = outputRate / inputRate;
+
+    // two of the larger buffer (in input frames) is enough headroom for both callbacks to
+    // jitter against each other, the ring holds a few times that
+    const auto outputBufferInInput = std::ceil(outputBufferSize / nominalRatio_);
+    targetFill_ = 2.0 * std::max(static_cast<double>(inputBufferSize), outputBufferInInput);
+    const auto capacity = std::bit_ceil(static_cast<unsigned int>(4.0 * targetFill_) + inputBufferSize);
+
+    ring_.assign(numChannels_, std::vector<float>(capacity, 0.0f));
+    ringMask_ = capacity - 1;
+    writeIndex_.store(0, std::memory_order_relaxed);
+    readIndex_.store(0, std::memory_order_relaxed);
+    writeTime_.store(0, std::memory_order_relaxed);
+    lastWriteFrames_.store(0, std::memory_order_relaxed);
+    overruns_.store(0, std::memory_order_relaxed);
+
+    resampler_.prepare(numChannels_, nominalRatio_, fx::Resampler::Quality::NORMAL);
+    planar_.assign(numChannels_, std::vector<float>(AudioEngine::MAX_FRAMES_IN_BUFFER, 0.0f));
+    inputPtrs_.resize(numChannels_);
+    outputPtrs_.resize(numChannels_);
+
+    // critically damped: the fill error e follows e'' + a e' + a^2/4 e = 0 with a = 1 / lock time,
+    // the integral takes out the constant part of the drift
+    const auto a = 1.0 / LOCK_TIME_SECONDS;
+    kp_ = a / inputRate_;
+    ki_ = a * a / (4.0 * inputRate_);
+    filteredFill_ = 0.0;
+    integral_ = 0.0;
+    priming_ = true;
+    ratio_.store(nominalRatio_, std::memory_order_relaxed);
+    underruns_.store(0, std::memory_order_relaxed);
+}
+
+void AsyncInput::write(const float *interleaved, unsigned int nFrames, Timestamp time) noexcept
+{
+    const auto write = writeIndex_.load(std::memory_order_relaxed);
+    const auto read = readIndex_.load(std::memory_order_acquire);
+    const auto capacity = static_cast<std::uint64_t>(ringMask_) + 1;
+
+    // the output side stopped reading, dropping the block keeps what is queued contiguous
+    if (!interleaved || write + nFrames - read > capacity) {
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    for (auto c{0u}; c < numChannels_; ++c) {
+        auto& ring = ring_[c];
+        for (auto i{0u}; i < nFrames; ++i)
+            ring[(write + i) & ringMask_] = interleaved[i * numChannels_ + c];
+    }
+
+    writeTime_.store(time, std::memory_order_relaxed);
+    lastWriteFrames_.store(nFrames, std::memory_order_relaxed);
+    writeIndex_.store(write + nFrames, std::memory_order_release);
+}
+
+void AsyncInput::read(float *interleaved, unsigned int nFrames, Timestamp time) noexcept
+{
+    const auto silence = [&] {
+        std::fill_n(interleaved, static_cast<std::size_t>(nFrames) * numChannels_, 0.0f);
+    };
+
+    nFrames = std::min(nFrames, AudioEngine::MAX_FRAMES_IN_BUFFER);
+    auto read = readIndex_.load(std::memory_order_relaxed);
+    const auto written = writeIndex_.load(std::memory_order_acquire);
+    const auto available = static_cast<double>(written - read);
+
+    // The raw fill is a sawtooth of whole input buffers whose phase against the output
+    // callbacks slowly slides with the drift, the loop would chase it. Extrapolating the input
+    // from the time of its last callback measures the fill that is actually there.
+    const auto sinceWrite = static_cast<double>(time - writeTime_.load(std::memory_order_relaxed)) * 1e-9;
+    const auto pending = std::clamp(sinceWrite * inputRate_, 0.0, static_cast<double>(lastWriteFrames_.load(std::memory_order_relaxed)));
+    const auto fill = available + pending;
+
+    if (priming_) {
+        if (available < targetFill_) {
+            silence();
+            return;
+        }
+        priming_ = false;
+        filteredFill_ = fill;
+        integral_ = 0.0;
+        resampler_.reset();
+    }
+
+    // PI loop on the smoothed fill, a filling ring means the input clock is faster, so more
+    // input frames are read per output frame
+    const auto dt = nFrames / outputRate_;
+    filteredFill_ += (1.0 - std::exp(-dt / FILL_SMOOTHING_SECONDS)) * (fill - filteredFill_);
+    const auto error = filteredFill_ - targetFill_;
+    integral_ = std::clamp(integral_ + error * dt, -MAX_CORRECTION / ki_, MAX_CORRECTION / ki_);
+    const auto correction = std::clamp(kp_ * error + ki_ * integral_, -MAX_CORRECTION, MAX_CORRECTION);
+
+    const auto ratio = nominalRatio_ / (1.0 + correction);
+    resampler_.setRatio(ratio);
+    ratio_.store(ratio, std::memory_order_relaxed);
+
+    if (available < resampler_.getInputFramesNeeded(nFrames)) {
+        // starts over at the target fill instead of crackling along an empty ring
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+        priming_ = true;
+        silence();
+        return;
+    }
+
+    // at most two contiguous pieces of the ring, before and after its end
+    unsigned int produced = 0;
+    while (produced < nFrames) {
+        const auto offset = static_cast<unsigned int>(read & ringMask_);
+        const auto contiguous = ringMask_ + 1 - offset;
+        for (auto c{0u}; c < numChannels_; ++c) {
+            inputPtrs_[c] = ring_[c].data() + offset;
+            outputPtrs_[c] = planar_[c].data() + produced;
+        }
+
+        unsigned int consumed = 0;
+        produced += resampler_.process(inputPtrs_.data(), contiguous, outputPtrs_.data(), nFrames - produced, consumed);
+        read += consumed;
+    }
+
+    readIndex_.store(read, std::memory_order_release);
+
+    for (auto c{0u}; c < numChannels_; ++c) {
+        const auto& channel = planar_[c];
+        for (auto i{0u}; i < nFrames; ++i)
+            interleaved[i * numChannels_ + c] = channel[i];
+    }
+}
+
+double AsyncInput::getLatency() const noexcept
+{
+    return (targetFill_ + resampler_.getLatency()) / inputRate_;
+}
+
+double AsyncInput::getRatio() const noexcept
+{
+    return ratio_.load(std::memory_order_relaxed);
+}
+
+unsigned int AsyncInput::getNumUnderruns() const noexcept
+{
+    return underruns_.load(std::memory_order_relaxed);
+}
+
+unsigned int AsyncInput::getNumOverruns() const noexcept
+{
+    return overruns_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "fx/resampler.h"
+#include "timestamp.h"
+
+namespace audio {
+
+    // Input from a device running on its own clock, e.g. a USB interface next to the built-in
+    // output. The input stream writes into a ring, the output stream reads it through a
+    // resampler whose ratio a PI loop on the ring fill adjusts, so the two clocks can drift
+    // apart for as long as the streams run without the ring ever running dry or over.
+    class AsyncInput
+    {
+    public:
+        // Not real-time safe, neither stream may be running
+        void prepare(unsigned int numChannels, double inputRate, double outputRate,
+                     unsigned int inputBufferSize, unsigned int outputBufferSize);
+
+        // -- Input stream --
+        // time is when the callback started, the fill is extrapolated from it in between
+        void write(const float *interleaved, unsigned int nFrames, Timestamp time) noexcept;
+
+        // -- Output stream --
+        // Writes nFrames interleaved frames, silence while the ring fills up (again)
+        void read(float *interleaved, unsigned int nFrames, Timestamp time) noexcept;
+
+        // Delay added by the ring and the resampler, in seconds
+        double getLatency() const noexcept;
+        double getRatio() const noexcept;
+        unsigned int getNumUnderruns() const noexcept;
+        unsigned int getNumOverruns() const noexcept;
+
+    private:
+        // Time constant of the drift correction and of the fill measurement it works on,
+        // the input arrives in bursts of whole buffers
+        static constexpr double LOCK_TIME_SECONDS = 2.0;
+        static constexpr double FILL_SMOOTHING_SECONDS = 0.25;
+        // Far beyond the drift of any real pair of clocks, 0.5%
+        static constexpr double MAX_CORRECTION = 0.005;
+
+        unsigned int numChannels_{0};
+        double inputRate_{0.0};
+        double outputRate_{0.0};
+        double nominalRatio_{1.0};
+
+        // ring, written by the input stream and read by the output stream
+        std::vector<std::vector<float>> ring_;
+        unsigned int ringMask_{0};
+        std::atomic<std::uint64_t> writeIndex_{0};
+        std::atomic<std::uint64_t> readIndex_{0};
+        std::atomic<Timestamp> writeTime_{0};
+        std::atomic<unsigned int> lastWriteFrames_{0};
+        std::atomic<unsigned int> overruns_{0};
+
+        // output stream state
+        fx::Resampler resampler_;
+        std::vector<std::vector<float>> planar_;
+        std::vector<const float*> inputPtrs_;
+        std::vector<float*> outputPtrs_;
+        double targetFill_{0.0};
+        double filteredFill_{0.0};
+        double integral_{0.0};
+        double kp_{0.0};
+        double ki_{0.0};
+        bool priming_{true};
+        std::atomic<double> ratio_{1.0};
+        std::atomic<unsigned int> underruns_{0};
+    };
+
+}
@@ -14,6 +14,9 @@ namespace audio {
         unsigned int maxInputChannels{2};
         unsigned int maxOutputChannels{2};
         std::vector<unsigned int> supportedSampleRates;
+        // default devices of their host API
+        bool isDefaultInput{false};
+        bool isDefaultOutput{false};
 
         void printInfo() const
         {
@@ -35,6 +38,11 @@ namespace audio {
     {
     public:
         using Callback = std::function<bool(const float *in, float *out, unsigned int nFrames)>;
+        // For backends whose buffers are already one per channel
+        using PlanarCallback = std::function<bool(const float *const *in, float *const *out, unsigned int nFrames)>;
+
+        // Most frames a callback is handed at once, larger host buffers are split into blocks
+        static constexpr unsigned int MAX_CALLBACK_FRAMES = 8096;
 
         struct StreamParams
         {
@@ -56,12 +64,51 @@ namespace audio {
 
         [[nodiscard]] virtual std::vector<AudioDevice> getAvailableDevices() = 0;
 
+        // Keeps probed device capabilities in the file at path between runs, rescan ignores
+        // what is stored there. Must be called before the first getAvailableDevices().
+        virtual void setCapabilityCache(const std::string& path, bool rescan) { (void) path; (void) rescan; }
+
+        // Backends with non-interleaved buffers hand them to this one instead, skipping the
+        // engine's (de)interleaving
+        void setPlanarCallback(PlanarCallback planarCallback) { planarCallback_ = std::move(planarCallback); }
+
+        // Servers that own the clock (JACK) replace the requested sample rate and buffer size
+        // with theirs, before anything gets prepared for them
+        virtual void constrainStreamParams(StreamParams& params) const { (void) params; }
+
         virtual bool startStream(int inputDeviceIndex, int outputDeviceIndex, StreamParams &params) = 0;
         virtual bool stopStream() = 0;
         [[nodiscard]] virtual bool isStreamRunning() const = 0;
 
+        // Gets the latencies of every stream in seconds, once they are known and before the
+        // stream's first audio callback
+        using LatencyCallback = std::function<void(double input, double output, unsigned int sampleRate)>;
+        void setLatencyCallback(LatencyCallback latencyCallback) { latencyCallback_ = std::move(latencyCallback); }
+
+        // Latencies of the open stream in seconds, including host buffering
+        [[nodiscard]] double getInputLatency() const { return inputLatency_; }
+        [[nodiscard]] double getOutputLatency() const { return outputLatency_; }
+
     protected:
+        // Called by startStream() before any audio callback can run
+        void reportLatency(double input, double output, unsigned int sampleRate)
+        {
+            inputLatency_ = input;
+            outputLatency_ = output;
+            std::cout << "Stream latency in/out: " << inputLatency_ * 1000.0 << "ms / "
+                      << outputLatency_ * 1000.0 << "ms" << std::endl;
+
+            if (latencyCallback_)
+                latencyCallback_(input, output, sampleRate);
+        }
+
         Callback audioCallback_;
+        PlanarCallback planarCallback_;
+
+    private:
+        LatencyCallback latencyCallback_;
+        double inputLatency_{0.0};
+        double outputLatency_{0.0};
     };
 
 }
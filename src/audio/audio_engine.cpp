@@ -2,11 +2,21 @@
 
 #include <iostream>
 #include <memory>
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "memory/page_memory.h"
 
 #define USE_PORTAUDIO
 
-#ifdef USE_PORTAUDIO
+#if defined(USE_JACK)
+    #include "jack_backend.h"
+    using DefaultAudioBackend = audio::JackBackend;
+#elif defined(USE_PORTAUDIO)
     #include "portaudio_backend.h"
     using DefaultAudioBackend = audio::PortAudioBackend;
 #else
@@ -16,6 +26,9 @@
 
 using namespace audio;
 
+// How long starting a stream waits for the first callback to report its thread set up
+static constexpr auto SETUP_REPORT_TIMEOUT = std::chrono::milliseconds(500);
+
 AudioEngine& AudioEngine::getInstance()
 {
     static AudioEngine instance;
@@ -30,6 +43,14 @@ AudioEngine::AudioEngine()
 
     try {
         backend_ = std::make_unique<DefaultAudioBackend>(std::move(audioCallback));
+        backend_->setPlanarCallback([this](const float *const *in, float *const *out, unsigned int nFrames) -> bool {
+            return this->planarCallback(in, out, nFrames);
+        });
+        // published before the stream calls back, so its first buffers are compensated too
+        backend_->setLatencyCallback([this](double input, double output, unsigned int sampleRate) {
+            inputLatency_.store(static_cast<unsigned int>(std::lround(input * sampleRate)), std::memory_order_relaxed);
+            outputLatency_.store(static_cast<unsigned int>(std::lround(output * sampleRate)), std::memory_order_relaxed);
+        });
     } catch (std::exception &e) {
         std::cerr << "Error creating audio backend: " << e.what() << std::endl;
     }
@@ -44,19 +65,23 @@ unsigned int AudioEngine::getNumInputChannels() const noexcept { return inputCha
 unsigned int AudioEngine::getNumOutputChannels() const noexcept { return outputChannels_; }
 unsigned int AudioEngine::getSampleRate() const noexcept { return sampleRate_.load(std::memory_order_relaxed); }
 unsigned int AudioEngine::getBufferSize() const noexcept { return bufferSize_.load(std::memory_order_relaxed); }
+unsigned int AudioEngine::getInputLatency() const noexcept { return inputLatency_.load(std::memory_order_relaxed); }
+unsigned int AudioEngine::getOutputLatency() const noexcept { return outputLatency_.load(std::memory_order_relaxed); }
+unsigned int AudioEngine::getRoundTripLatency() const noexcept { return getInputLatency() + getOutputLatency(); }
+Timestamp AudioEngine::getCallbackTime() const noexcept { return callbackTime_.load(std::memory_order_relaxed); }
 
 void AudioEngine::setSampleRate(unsigned int sampleRate)
 {
     sampleRate_.store(sampleRate, std::memory_order_relaxed);
     if (isRunning())
-        restart();
+        reconfigure();
 }
 
 void AudioEngine::setBufferSize(unsigned int bufferSize)
 {
     bufferSize_.store(bufferSize, std::memory_order_relaxed);
     if (isRunning())
-        restart();
+        reconfigure();
 }
 
 void AudioEngine::setAudioCallback(std::shared_ptr<AudioCallback> cb)
@@ -73,12 +98,17 @@ void AudioEngine::setAudioCallback(std::shared_ptr<AudioCallback> cb)
 bool AudioEngine::start()
 {
     std::lock_guard<std::mutex> lock(streamMutex_);
+    return openStream(false);
+}
 
+bool AudioEngine::openStream(bool resume)
+{
     AudioBackend::StreamParams params;
     params.sampleRate = sampleRate_.load(std::memory_order_relaxed);
     params.bufferSize = bufferSize_.load(std::memory_order_relaxed);
     params.numInputChannels = inputChannels_;
     params.numOutputChannels = outputChannels_;
+    backend_->constrainStreamParams(params);
 
     sampleRate_.store(params.sampleRate, std::memory_order_relaxed);
     bufferSize_.store(params.bufferSize, std::memory_order_relaxed);
@@ -89,14 +119,33 @@ bool AudioEngine::start()
     inputData_.setNumChannels(inputChannels_);
     outputData_.setNumChannels(outputChannels_);
 
-    if (const auto cb = userCallback_.load(std::memory_order_relaxed))
-        cb->onStart();
+    if (const auto cb = userCallback_.load(std::memory_order_relaxed)) {
+        if (resume)
+            cb->onResume();
+        else
+            cb->onStart();
+    }
 
+    // the callback has allocated everything it needs by now
+    if (realtimeSettings_.lockMemory)
+        memory::lockProcessMemory();
+
+    audioThreadSetUp_ = false;
+    setUpDone_.store(false, std::memory_order_relaxed);
+    setUpReported_ = false;
     if (!backend_->startStream(inputDeviceIndex_, outputDeviceIndex_, params)) {
         std::cerr << "Error starting stream\n";
         return false;
     }
 
+    // the audio thread sets itself up on its first callback, what failed is printed here
+    if (realtimeSettings_.cpu >= 0 || realtimeSettings_.priority > 0) {
+        const auto deadline = std::chrono::steady_clock::now() + SETUP_REPORT_TIMEOUT;
+        while (!setUpDone_.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        reportAudioThreadSetUp();
+    }
+
     return true;
 }
 
@@ -104,11 +153,17 @@ bool AudioEngine::stop()
 {
     std::lock_guard<std::mutex> lock(streamMutex_);
 
+    // a first callback that came after start() stopped waiting for it
+    reportAudioThreadSetUp();
+
     if (!backend_->stopStream()) {
         std::cerr << "Error closing stream\n";
         return false;
     }
 
+    inputLatency_.store(0, std::memory_order_relaxed);
+    outputLatency_.store(0, std::memory_order_relaxed);
+
     if (const auto cb = userCallback_.load(std::memory_order_relaxed))
         cb->onStop();
 
@@ -120,6 +175,25 @@ bool AudioEngine::restart()
     return stop() && start();
 }
 
+bool AudioEngine::reconfigure()
+{
+    std::lock_guard<std::mutex> lock(streamMutex_);
+
+    if (!backend_->stopStream()) {
+        std::cerr << "Error closing stream\n";
+        return false;
+    }
+
+    // the next stream reports its own before it starts
+    inputLatency_.store(0, std::memory_order_relaxed);
+    outputLatency_.store(0, std::memory_order_relaxed);
+
+    if (const auto cb = userCallback_.load(std::memory_order_relaxed))
+        cb->onSuspend();
+
+    return openStream(true);
+}
+
 bool AudioEngine::isRunning() const
 {
     std::lock_guard<std::mutex> lock(streamMutex_);
@@ -151,8 +225,117 @@ void AudioEngine::pickDevices()
     outputDeviceIndex_ = outputDeviceIndex;
 }
 
+void AudioEngine::setDevices(int inputDeviceIndex, int outputDeviceIndex)
+{
+    inputDeviceIndex_ = inputDeviceIndex;
+    outputDeviceIndex_ = outputDeviceIndex;
+    if (isRunning())
+        reconfigure();
+}
+
+std::vector<AudioDevice> AudioEngine::getAvailableDevices() const
+{
+    return backend_ ? backend_->getAvailableDevices() : std::vector<AudioDevice>{};
+}
+
+void AudioEngine::setDeviceCache(const std::string& path, bool rescan)
+{
+    if (backend_)
+        backend_->setCapabilityCache(path, rescan);
+}
+
+void AudioEngine::setRealtimeSettings(const RealtimeSettings& settings)
+{
+    realtimeSettings_ = settings;
+}
+
+static bool containsIgnoringCase(const std::string& text, const std::string& part)
+{
+    const auto lower = [](unsigned char c) { return static_cast<char>(std::tolower(c)); };
+    return !std::ranges::search(text, part, {}, lower, lower).empty();
+}
+
+int AudioEngine::findDevice(const std::string& name, const std::string& hostApi, bool input) const
+{
+    if (name.empty() && hostApi.empty())
+        return -1;
+
+    const auto devices = getAvailableDevices();
+    const auto sampleRate = getSampleRate();
+
+    const auto hasChannels = [&](const AudioDevice& device) {
+        return (input ? device.maxInputChannels : device.maxOutputChannels) > 0;
+    };
+    const auto supportsRate = [&](const AudioDevice& device) {
+        return std::ranges::find(device.supportedSampleRates, sampleRate) != device.supportedSampleRates.end();
+    };
+
+    // the host API weighs more than an exact name, which weighs more than the sample rate
+    const auto rank = [&](const AudioDevice& device) {
+        const auto inHostApi = hostApi.empty() || containsIgnoringCase(device.hostApiName, hostApi);
+        auto score = 0;
+        if (name.empty()) {
+            if (!(input ? device.isDefaultInput : device.isDefaultOutput)) return -1;
+        } else if (device.deviceName == name) {
+            score += 2;
+        } else if (!containsIgnoringCase(device.deviceName, name)) {
+            return -1;
+        }
+        if (inHostApi) score += 4;
+        else if (name.empty()) return -1;
+        if (supportsRate(device)) score += 1;
+        return score;
+    };
+
+    auto best = -1;
+    auto bestScore = -1;
+    for (const auto& device : devices) {
+        if (!hasChannels(device)) continue;
+        if (const auto score = rank(device); score > bestScore) {
+            best = device.deviceIndex;
+            bestScore = score;
+        }
+    }
+
+    const auto* kind = input ? "input" : "output";
+    if (best < 0) {
+        const auto what = name.empty() ? std::string("default") : "\"" + name + "\"";
+        std::cerr << "No " << what << " " << kind << " device" << (hostApi.empty() ? "" : " on " + hostApi)
+                  << ", using the default device" << std::endl;
+    } else if (!hostApi.empty() && (bestScore & 4) == 0) {
+        std::cerr << "No " << kind << " device \"" << name << "\" on " << hostApi << ", using one of another host API" << std::endl;
+    }
+
+    return best;
+}
+
+void AudioEngine::setUpAudioThread() noexcept
+{
+    audioThreadSetUp_ = true;
+    flushDenormalsToZero();
+
+    const auto errors = applyRealtimeSettings(realtimeSettings_);
+    affinityError_.store(errors.affinity, std::memory_order_relaxed);
+    priorityError_.store(errors.priority, std::memory_order_relaxed);
+    setUpDone_.store(true, std::memory_order_release);
+}
+
+void AudioEngine::reportAudioThreadSetUp()
+{
+    if (setUpReported_ || !setUpDone_.load(std::memory_order_acquire)) return;
+    setUpReported_ = true;
+
+    const RealtimeErrors errors{affinityError_.load(std::memory_order_relaxed), priorityError_.load(std::memory_order_relaxed)};
+    reportRealtimeErrors(realtimeSettings_, errors);
+}
+
 bool AudioEngine::callback(const float *in, float *out, unsigned int nFrames)
 {
+    if (!audioThreadSetUp_)
+        setUpAudioThread();
+
+    callbackTime_.store(timestampNow(), std::memory_order_relaxed);
+
     if (const auto cb = userCallback_.load(std::memory_order_relaxed)) {
         inputData_.deinterleave(in, nFrames);
         cb->onProcess(inputData_.planar.data(), outputData_.planar.data(), nFrames);
@@ -162,6 +345,19 @@ bool AudioEngine::callback(const float *in, float *out, unsigned int nFrames)
     return true;
 }
 
+bool AudioEngine::planarCallback(const float *const *in, float *const *out, unsigned int nFrames)
+{
+    if (!audioThreadSetUp_)
+        setUpAudioThread();
+
+    callbackTime_.store(timestampNow(), std::memory_order_relaxed);
+
+    if (const auto cb = userCallback_.load(std::memory_order_relaxed))
+        cb->onProcess(in, out, nFrames);
+
+    return true;
+}
+
 void AudioEngine::PlanarAudioData::setNumChannels(unsigned int numChannels)
 {
     planar.clear();
@@ -4,10 +4,13 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <string>
 
-namespace audio {
+#include "audio_backend.h"
+#include "realtime_thread.h"
+#include "timestamp.h"
 
-    class AudioBackend;
+namespace audio {
 
     class AudioCallback
     {
@@ -24,6 +27,12 @@ namespace audio {
         virtual void onStart() = 0;
         virtual void onStop() = 0;
 
+        // A reconfiguration reopens the stream with new settings without ending the session:
+        // onSuspend() after the old stream stopped, onResume() before the new one starts.
+        // Callbacks that keep no state across streams can leave them as a full stop/start.
+        virtual void onSuspend() { onStop(); }
+        virtual void onResume() { onStart(); }
+
     protected:
         AudioCallback() = default;
     };
@@ -31,6 +40,8 @@ namespace audio {
     class AudioEngine
     {
     public:
+        static constexpr unsigned int MAX_FRAMES_IN_BUFFER = AudioBackend::MAX_CALLBACK_FRAMES;
+
         static AudioEngine& getInstance();
 
         AudioEngine(const AudioEngine&) = delete;
@@ -44,6 +55,10 @@ namespace audio {
         unsigned int getNumOutputChannels() const noexcept;
         unsigned int getSampleRate() const noexcept;
         unsigned int getBufferSize() const noexcept;
+        unsigned int getInputLatency() const noexcept;
+        unsigned int getOutputLatency() const noexcept;
+        unsigned int getRoundTripLatency() const noexcept;
+        Timestamp getCallbackTime() const noexcept;
         // -------------------------------------------------------------
 
         void setSampleRate(unsigned int sampleRate);
@@ -53,14 +68,35 @@ namespace audio {
         bool start();
         bool stop();
         bool restart();
+        // Reopens a running stream with the current settings, the callback keeps its state
+        bool reconfigure();
         bool isRunning() const;
         void pickDevices();
+        // -1 picks the backend's default device
+        void setDevices(int inputDeviceIndex, int outputDeviceIndex);
+        std::vector<AudioDevice> getAvailableDevices() const;
+        // Keeps probed device capabilities in the file at path between runs, rescan probes again.
+        // Has to come before anything lists devices.
+        void setDeviceCache(const std::string& path, bool rescan);
+        // Index of the device called name, exact names first, then case insensitive substrings.
+        // Devices of hostApi and devices supporting the current sample rate are preferred, an
+        // empty name picks the default device of hostApi. -1 (backend default) if nothing matches.
+        int findDevice(const std::string& name, const std::string& hostApi, bool input) const;
+        // Applied by the audio thread to itself on its first callback, takes effect on the next start
+        void setRealtimeSettings(const RealtimeSettings& settings);
 
     private:
         AudioEngine();
         ~AudioEngine();
 
         bool callback(const float *in, float *out, unsigned int nFrames);
+        bool planarCallback(const float *const *in, float *const *out, unsigned int nFrames);
+        // the backends create their audio threads, so they are set up from inside
+        void setUpAudioThread() noexcept;
+        // prints what the audio thread's setup ran into, once it has run
+        void reportAudioThreadSetUp();
+        // streamMutex_ must be held
+        bool openStream(bool resume);
 
         std::unique_ptr<AudioBackend> backend_;
 
@@ -71,6 +107,22 @@ namespace audio {
         std::atomic<unsigned int> sampleRate_{48000};
         std::atomic<unsigned int> bufferSize_{256};
 
+        // in frames, reported by the backend once the stream is open
+        std::atomic<unsigned int> inputLatency_{0};
+        std::atomic<unsigned int> outputLatency_{0};
+
+        // time the current/last callback started
+        std::atomic<Timestamp> callbackTime_{0};
+
+        RealtimeSettings realtimeSettings_;
+        // cleared before every stream start, only touched by the audio thread after that
+        bool audioThreadSetUp_{false};
+        // set up failures, published by the audio thread and printed by the control thread
+        std::atomic<int> affinityError_{0};
+        std::atomic<int> priorityError_{0};
+        std::atomic<bool> setUpDone_{false};
+        bool setUpReported_{true};
+
         int inputDeviceIndex_{-1};
         int outputDeviceIndex_{-1};
 
@@ -83,7 +135,6 @@ namespace audio {
             void deinterleave(const float *data, unsigned int nFrames);
             void interleave(float *data, unsigned int nFrames);
 
-            static constexpr unsigned int MAX_FRAMES_IN_BUFFER = 8096;
             std::vector<float*> planar;
             std::vector<std::vector<float>> buffers;
         };
@@ -0,0 +1,140 @@
+#include "device_cache.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+using namespace audio;
+
+static constexpr std::string_view FILE_HEADER = "# MiniLooper device cache v1";
+
+// fields are tab separated, device names must not break the line format
+static std::string sanitize(std::string text)
+{
+    for (auto& c : text) {
+        if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+    }
+    return text;
+}
+
+std::string DeviceCache::makeKey(const std::string& hostApiName, const std::string& deviceName,
+                                 unsigned int maxInputChannels, unsigned int maxOutputChannels,
+                                 double defaultSampleRate)
+{
+    return sanitize(hostApiName) + '\t' + sanitize(deviceName) + '\t'
+        + std::to_string(maxInputChannels) + '\t' + std::to_string(maxOutputChannels) + '\t'
+        + std::to_string(std::lround(defaultSampleRate));
+}
+
+std::string DeviceCache::getDefaultPath()
+{
+#if defined(_WIN32)
+    const char* base = std::getenv("LOCALAPPDATA");
+    if (!base || !*base) return {};
+    return (std::filesystem::path(base) / "MiniLooper" / "devices.cache").string();
+#else
+    if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache)
+        return (std::filesystem::path(cache) / "minilooper" / "devices.cache").string();
+    const char* home = std::getenv("HOME");
+    if (!home || !*home) return {};
+    return (std::filesystem::path(home) / ".cache" / "minilooper" / "devices.cache").string();
+#endif
+}
+
+bool DeviceCache::load(const std::string& path)
+{
+    path_ = path;
+    entries_.clear();
+    dirty_ = false;
+
+    std::ifstream file(path);
+    if (!file) return true;
+
+    std::string line;
+    if (!std::getline(file, line) || line != FILE_HEADER) {
+        // unknown format, it gets rewritten after the next probe
+        std::cerr << "Ignoring device cache " << path << std::endl;
+        return false;
+    }
+
+    while (std::getline(file, line)) {
+        // key fields, then the comma separated rates after the last tab
+        const auto split = line.rfind('\t');
+        if (split == std::string::npos) continue;
+
+        std::vector<unsigned int> sampleRates;
+        auto rates = std::string_view(line).substr(split + 1);
+        while (!rates.empty()) {
+            unsigned int rate = 0;
+            const auto result = std::from_chars(rates.data(), rates.data() + rates.size(), rate);
+            if (result.ec != std::errc()) break;
+            sampleRates.push_back(rate);
+            rates.remove_prefix(static_cast<std::size_t>(result.ptr - rates.data()));
+            if (!rates.empty() && rates.front() == ',') rates.remove_prefix(1);
+        }
+
+        entries_[line.substr(0, split)] = std::move(sampleRates);
+    }
+
+    return true;
+}
+
+void DeviceCache::reset(const std::string& path)
+{
+    path_ = path;
+    entries_.clear();
+    dirty_ = true;
+}
+
+bool DeviceCache::save()
+{
+    if (!dirty_ || path_.empty()) return true;
+
+    std::error_code error;
+    const auto directory = std::filesystem::path(path_).parent_path();
+    if (!directory.empty())
+        std::filesystem::create_directories(directory, error);
+
+    // written next to the cache and renamed, a crash mid-write leaves the old file intact
+    const auto temporary = path_ + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Failed to write device cache " << path_ << std::endl;
+            return false;
+        }
+
+        file << FILE_HEADER << '\n';
+        for (const auto& [key, sampleRates] : entries_) {
+            file << key << '\t';
+            for (auto i{0u}; i < sampleRates.size(); ++i)
+                file << (i > 0 ? "," : "") << sampleRates[i];
+            file << '\n';
+        }
+    }
+
+    std::filesystem::rename(temporary, path_, error);
+    if (error) {
+        std::cerr << "Failed to write device cache " << path_ << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    dirty_ = false;
+    return true;
+}
+
+const std::vector<unsigned int>* DeviceCache::find(const std::string& key) const
+{
+    const auto it = entries_.find(key);
+    return it != entries_.end() ? &it->second : nullptr;
+}
+
+void DeviceCache::insert(const std::string& key, std::vector<unsigned int> sampleRates)
+{
+    entries_[key] = std::move(sampleRates);
+    dirty_ = true;
+}
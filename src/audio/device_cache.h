@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace audio {
+
+    // Probed sample rates per device, kept on disk so startup does not have to ask every device
+    // for every rate again. Devices are keyed by host API, name, channel counts and default rate,
+    // indices are not stable between runs.
+    class DeviceCache
+    {
+    public:
+        static std::string makeKey(const std::string& hostApiName, const std::string& deviceName,
+                                   unsigned int maxInputChannels, unsigned int maxOutputChannels,
+                                   double defaultSampleRate);
+
+        // Per user cache file, empty when no home/cache directory is known
+        static std::string getDefaultPath();
+
+        // A missing file is an empty cache, not an error
+        bool load(const std::string& path);
+        // Starts empty, the next save replaces the file at path
+        void reset(const std::string& path);
+        bool save();
+
+        [[nodiscard]] const std::vector<unsigned int>* find(const std::string& key) const;
+        void insert(const std::string& key, std::vector<unsigned int> sampleRates);
+
+        [[nodiscard]] const std::string& getPath() const noexcept { return path_; }
+
+    private:
+        std::string path_;
+        std::unordered_map<std::string, std::vector<unsigned int>> entries_;
+        bool dirty_{false};
+    };
+
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <jack/jack.h>
+
+#include "audio_backend.h"
+
+namespace audio {
+
+    // JACK client with one port per channel, connected to the physical ports on start. The
+    // server owns the sample rate and period, and its port buffers are already planar, so they
+    // go to the engine's planar callback as they are. Runs against the dummy driver
+    // (jackd -d dummy) without any audio hardware.
+    //
+    // A period the server switches to while running reaches the callbacks in blocks of at most
+    // the period the stream started with, which is what the engine and its callback prepared for.
+    class JackBackend final : public AudioBackend
+    {
+    public:
+        explicit JackBackend(Callback audioCallback) : AudioBackend(std::move(audioCallback))
+        {
+            jack_status_t status{};
+            client_ = jack_client_open(CLIENT_NAME, JackNoStartServer, &status);
+            if (!client_)
+                throw std::runtime_error("Failed to connect to the JACK server, is it running?");
+
+            jack_set_process_callback(client_, &processCallback, this);
+            jack_set_buffer_size_callback(client_, &bufferSizeCallback, this);
+            jack_on_shutdown(client_, &shutdownCallback, this);
+        }
+
+        ~JackBackend() override
+        {
+            if (running_.load(std::memory_order_relaxed))
+                jack_deactivate(client_);
+            jack_client_close(client_);
+        }
+
+        // The server is the only device, its channels are the physical ports
+        [[nodiscard]] std::vector<AudioDevice> getAvailableDevices() override
+        {
+            AudioDevice device;
+            device.deviceIndex = 0;
+            device.deviceName = "JACK server";
+            device.hostApiName = "JACK";
+            device.maxInputChannels = countPhysicalPorts(JackPortIsOutput);
+            device.maxOutputChannels = countPhysicalPorts(JackPortIsInput);
+            device.supportedSampleRates = {jack_get_sample_rate(client_)};
+            device.isDefaultInput = true;
+            device.isDefaultOutput = true;
+            return {device};
+        }
+
+        void constrainStreamParams(StreamParams& params) const override
+        {
+            params.sampleRate = jack_get_sample_rate(client_);
+            params.bufferSize = jack_get_buffer_size(client_);
+        }
+
+        bool startStream(int inputDeviceIndex, int outputDeviceIndex, StreamParams &params) override
+        {
+            (void) inputDeviceIndex;
+            (void) outputDeviceIndex;
+
+            if (isStreamRunning()) {
+                std::cerr << "Stream is already running" << std::endl;
+                return false;
+            }
+
+            constrainStreamParams(params);
+
+            if (!registerPorts(inputPorts_, params.numInputChannels, "in_", JackPortIsInput)
+                || !registerPorts(outputPorts_, params.numOutputChannels, "out_", JackPortIsOutput)) {
+                unregisterPorts();
+                return false;
+            }
+
+            inputPortBuffers_.assign(inputPorts_.size(), nullptr);
+            outputPortBuffers_.assign(outputPorts_.size(), nullptr);
+            inputBuffers_.assign(inputPorts_.size(), nullptr);
+            outputBuffers_.assign(outputPorts_.size(), nullptr);
+
+            blockFrames_ = std::clamp(params.bufferSize, 1u, MAX_CALLBACK_FRAMES);
+            periodFrames_.store(params.bufferSize, std::memory_order_relaxed);
+
+            // the process callback plays silence until running_ is set, port latencies are only
+            // known once the client is active and connected
+            if (jack_activate(client_) != 0) {
+                std::cerr << "JACK error activating client" << std::endl;
+                unregisterPorts();
+                return false;
+            }
+
+            connectPhysicalPorts();
+
+            std::cout << "JACK client: " << jack_get_client_name(client_) << ", " << params.sampleRate << " Hz, "
+                      << params.bufferSize << " frames per period" << std::endl;
+            if (jack_is_realtime(client_))
+                std::cout << "JACK real-time priority: " << jack_client_real_time_priority(client_) << std::endl;
+            else
+                std::cout << "JACK server is not running real-time" << std::endl;
+
+            const auto sampleRate = static_cast<double>(params.sampleRate);
+            reportLatency(getPortLatency(inputPorts_, JackCaptureLatency) / sampleRate,
+                          getPortLatency(outputPorts_, JackPlaybackLatency) / sampleRate, params.sampleRate);
+            running_.store(true, std::memory_order_release);
+
+            return true;
+        }
+
+        bool stopStream() override
+        {
+            if (!isStreamRunning()) {
+                std::cerr << "JACK client is already not running" << std::endl;
+                return false;
+            }
+
+            running_.store(false, std::memory_order_relaxed);
+            if (jack_deactivate(client_) != 0) {
+                std::cerr << "JACK error deactivating client" << std::endl;
+                return false;
+            }
+
+            unregisterPorts();
+
+            if (const auto period = periodFrames_.load(std::memory_order_relaxed); period != blockFrames_)
+                std::cout << "JACK period changed to " << period << " frames while running, processed in blocks of "
+                          << blockFrames_ << std::endl;
+            return true;
+        }
+
+        [[nodiscard]] bool isStreamRunning() const override
+        {
+            return running_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr const char* CLIENT_NAME = "MiniLooper";
+
+        bool registerPorts(std::vector<jack_port_t*>& ports, unsigned int numChannels, const std::string& prefix,
+                           unsigned long flags)
+        {
+            for (auto c{0u}; c < numChannels; ++c) {
+                const auto name = prefix + std::to_string(c + 1);
+                auto* port = jack_port_register(client_, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, flags, 0);
+                if (!port) {
+                    std::cerr << "JACK error registering port " << name << std::endl;
+                    return false;
+                }
+                ports.push_back(port);
+            }
+            return true;
+        }
+
+        void unregisterPorts()
+        {
+            for (auto* port : inputPorts_)
+                jack_port_unregister(client_, port);
+            for (auto* port : outputPorts_)
+                jack_port_unregister(client_, port);
+            inputPorts_.clear();
+            outputPorts_.clear();
+        }
+
+        unsigned int countPhysicalPorts(unsigned long flags) const
+        {
+            const auto** ports = jack_get_ports(client_, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical | flags);
+            if (!ports) return 0;
+
+            unsigned int count = 0;
+            while (ports[count]) ++count;
+            jack_free(ports);
+            return count;
+        }
+
+        // capture ports feed our inputs, our outputs feed the playback ports, channel by channel
+        void connectPhysicalPorts()
+        {
+            if (const auto** capture = jack_get_ports(client_, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical | JackPortIsOutput)) {
+                for (auto c{0u}; c < inputPorts_.size() && capture[c]; ++c) {
+                    if (jack_connect(client_, capture[c], jack_port_name(inputPorts_[c])) != 0)
+                        std::cerr << "JACK error connecting " << capture[c] << std::endl;
+                }
+                jack_free(capture);
+            }
+
+            if (const auto** playback = jack_get_ports(client_, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical | JackPortIsInput)) {
+                for (auto c{0u}; c < outputPorts_.size() && playback[c]; ++c) {
+                    if (jack_connect(client_, jack_port_name(outputPorts_[c]), playback[c]) != 0)
+                        std::cerr << "JACK error connecting " << playback[c] << std::endl;
+                }
+                jack_free(playback);
+            }
+        }
+
+        // worst case over the ports, in frames, including the server's periods
+        static jack_nframes_t getPortLatency(const std::vector<jack_port_t*>& ports, jack_latency_callback_mode_t mode)
+        {
+            jack_nframes_t latency = 0;
+            for (auto* port : ports) {
+                jack_latency_range_t range{};
+                jack_port_get_latency_range(port, mode, &range);
+                latency = std::max(latency, range.max);
+            }
+            return latency;
+        }
+
+        static int processCallback(jack_nframes_t nFrames, void *userData)
+        {
+            auto *backend = static_cast<JackBackend*>(userData);
+
+            for (auto c{0u}; c < backend->inputPorts_.size(); ++c)
+                backend->inputPortBuffers_[c] = static_cast<const float*>(jack_port_get_buffer(backend->inputPorts_[c], nFrames));
+
+            for (auto c{0u}; c < backend->outputPorts_.size(); ++c) {
+                auto* buffer = static_cast<float*>(jack_port_get_buffer(backend->outputPorts_[c], nFrames));
+                std::fill_n(buffer, nFrames, 0.0f);
+                backend->outputPortBuffers_[c] = buffer;
+            }
+
+            if (!backend->planarCallback_ || !backend->running_.load(std::memory_order_acquire))
+                return 0;
+
+            // a period larger than the one we started with goes out in blocks of that size
+            for (jack_nframes_t done = 0; done < nFrames;) {
+                const auto n = std::min<jack_nframes_t>(nFrames - done, backend->blockFrames_);
+                for (auto c{0u}; c < backend->inputBuffers_.size(); ++c)
+                    backend->inputBuffers_[c] = backend->inputPortBuffers_[c] + done;
+                for (auto c{0u}; c < backend->outputBuffers_.size(); ++c)
+                    backend->outputBuffers_[c] = backend->outputPortBuffers_[c] + done;
+
+                backend->planarCallback_(backend->inputBuffers_.data(), backend->outputBuffers_.data(), n);
+                done += n;
+            }
+
+            return 0;
+        }
+
+        // JACK2 calls this from its notification thread, JACK1 from the process thread, so it only
+        // records the new period. Printed by stopStream().
+        static int bufferSizeCallback(jack_nframes_t nFrames, void *userData)
+        {
+            auto *backend = static_cast<JackBackend*>(userData);
+            backend->periodFrames_.store(nFrames, std::memory_order_relaxed);
+            return 0;
+        }
+
+        static void shutdownCallback(void *userData)
+        {
+            auto *backend = static_cast<JackBackend*>(userData);
+            backend->running_.store(false, std::memory_order_relaxed);
+            std::cerr << "JACK server shut down" << std::endl;
+        }
+
+        jack_client_t* client_{nullptr};
+        std::atomic<bool> running_{false};
+
+        std::vector<jack_port_t*> inputPorts_;
+        std::vector<jack_port_t*> outputPorts_;
+        // the ports' buffers for the whole period, and the block of them handed to the callback
+        std::vector<const float*> inputPortBuffers_;
+        std::vector<float*> outputPortBuffers_;
+        std::vector<const float*> inputBuffers_;
+        std::vector<float*> outputBuffers_;
+
+        // callback block size, the period at start capped to MAX_CALLBACK_FRAMES
+        unsigned int blockFrames_{MAX_CALLBACK_FRAMES};
+        std::atomic<unsigned int> periodFrames_{0};
+    };
+
+} // audio
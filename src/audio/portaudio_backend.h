@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <utility>
+#include <vector>
 
 #include <portaudio.h>
 
@@ -10,7 +12,10 @@
     #include <pa_win_wasapi.h>
 #endif
 
+#include "async_input.h"
 #include "audio_backend.h"
+#include "device_cache.h"
+#include "timestamp.h"
 
 namespace audio {
 
@@ -23,8 +28,6 @@ namespace audio {
                 Pa_Terminate();
                 throw std::runtime_error(Pa_GetErrorText(err));
             }
-
-            scanDevices();
         }
 
         ~PortAudioBackend() override
@@ -32,12 +35,23 @@ namespace audio {
             Pa_Terminate();
         }
 
+        // Probing every sample rate takes seconds on some host APIs, so devices are only scanned
+        // once, on first use, and the probed rates come from the capability cache when set
         [[nodiscard]] std::vector<AudioDevice> getAvailableDevices() override
         {
-            scanDevices();
+            if (!scanned_)
+                scanDevices();
             return devices_;
         }
 
+        void setCapabilityCache(const std::string& path, bool rescan) override
+        {
+            if (rescan)
+                cache_.reset(path);
+            else
+                cache_.load(path);
+        }
+
         bool startStream(int inputDeviceIndex, int outputDeviceIndex, StreamParams &params) override
         {
             if (isStreamRunning()) {
@@ -83,6 +97,9 @@ namespace audio {
             const auto outputHostApiInfo = Pa_GetHostApiInfo(outputDeviceInfo->hostApi);
             std::cout << "Output Host Api: " << outputHostApiInfo->name << std::endl;
 
+            if (inputDevice != outputDevice)
+                return startSeparateStreams(inputParameters, outputParameters, params);
+
             if (Pa_IsFormatSupported(&inputParameters, &outputParameters, params.sampleRate) != paFormatIsSupported) {
                 std::cerr << "Format not supported by devices used" << std::endl;
                 return false;
@@ -104,8 +121,14 @@ namespace audio {
                 }
             }
 
+            // known once the stream is open, published before it calls back
+            const auto* streamInfo = Pa_GetStreamInfo(stream_);
+            reportLatency(streamInfo ? streamInfo->inputLatency : 0.0, streamInfo ? streamInfo->outputLatency : 0.0,
+                          params.sampleRate);
+
             if (const auto err = Pa_StartStream(stream_); err != paNoError) {
                 std::cerr << "PortAudio error starting stream: " << Pa_GetErrorText(err) << std::endl;
+                discardStreams();
                 return false;
             }
 
@@ -119,14 +142,18 @@ namespace audio {
                 return false;
             }
 
-            if (const auto err = Pa_StopStream(stream_); err != paNoError) {
-                std::cerr << "PortAudio error stopping stream: " << Pa_GetErrorText(err) << std::endl;
+            if (!closeStream(stream_))
                 return false;
-            }
 
-            if (const auto err = Pa_CloseStream(stream_); err != paNoError) {
-                std::cerr << "PortAudio error closing stream: " << Pa_GetErrorText(err) << std::endl;
-                return false;
+            if (inputStream_) {
+                if (!closeStream(inputStream_))
+                    return false;
+
+                if (const auto underruns = asyncInput_.getNumUnderruns(), overruns = asyncInput_.getNumOverruns();
+                    underruns > 0 || overruns > 0) {
+                    std::cout << "Input device dropouts: " << underruns << " underruns, "
+                              << overruns << " overruns" << std::endl;
+                }
             }
 
             return true;
@@ -144,6 +171,107 @@ namespace audio {
         }
 
     private:
+        // Separate devices run on separate clocks (and often can't share a duplex stream at all),
+        // so each gets its own stream and the input reaches the output callback through a
+        // drift-compensating resampler. The input keeps its own rate when it can't run at ours.
+        bool startSeparateStreams(const PaStreamParameters& inputParameters, const PaStreamParameters& outputParameters,
+                                  const StreamParams& params)
+        {
+            if (Pa_IsFormatSupported(nullptr, &outputParameters, params.sampleRate) != paFormatIsSupported) {
+                std::cerr << "Format not supported by output device" << std::endl;
+                return false;
+            }
+
+            const auto inputRate = getInputRate(inputParameters, params.sampleRate);
+            if (inputRate <= 0.0) {
+                std::cerr << "Format not supported by input device" << std::endl;
+                return false;
+            }
+
+            // same buffer duration on both sides
+            const auto inputBufferSize = static_cast<unsigned int>(std::lround(params.bufferSize * inputRate / params.sampleRate));
+            asyncInput_.prepare(static_cast<unsigned int>(inputParameters.channelCount), inputRate, params.sampleRate,
+                                inputBufferSize, params.bufferSize);
+            inputScratch_.assign(static_cast<std::size_t>(params.bufferSize) * inputParameters.channelCount, 0.0f);
+
+            if (const auto err = Pa_OpenStream(&inputStream_, &inputParameters, nullptr, inputRate, inputBufferSize,
+                                               paNoFlag, &paInputCallback, this); err != paNoError) {
+                std::cerr << "PortAudio error opening input stream: " << Pa_GetErrorText(err) << std::endl;
+                inputStream_ = nullptr;
+                return false;
+            }
+
+            if (const auto err = Pa_OpenStream(&stream_, nullptr, &outputParameters, params.sampleRate, params.bufferSize,
+                                               paNoFlag, &paOutputCallback, this); err != paNoError) {
+                std::cerr << "PortAudio error opening output stream: " << Pa_GetErrorText(err) << std::endl;
+                stream_ = nullptr;
+                discardStreams();
+                return false;
+            }
+
+            std::cout << "Separate input/output streams, input at " << inputRate << " Hz" << std::endl;
+            const auto* inputInfo = Pa_GetStreamInfo(inputStream_);
+            const auto* outputInfo = Pa_GetStreamInfo(stream_);
+            reportLatency((inputInfo ? inputInfo->inputLatency : 0.0) + asyncInput_.getLatency(),
+                          outputInfo ? outputInfo->outputLatency : 0.0, params.sampleRate);
+
+            // input first, the output plays silence until the ring has filled up
+            if (const auto err = Pa_StartStream(inputStream_); err != paNoError) {
+                std::cerr << "PortAudio error starting input stream: " << Pa_GetErrorText(err) << std::endl;
+                discardStreams();
+                return false;
+            }
+
+            if (const auto err = Pa_StartStream(stream_); err != paNoError) {
+                std::cerr << "PortAudio error starting output stream: " << Pa_GetErrorText(err) << std::endl;
+                discardStreams();
+                return false;
+            }
+
+            return true;
+        }
+
+        static double getInputRate(const PaStreamParameters& inputParameters, double sampleRate)
+        {
+            if (Pa_IsFormatSupported(&inputParameters, nullptr, sampleRate) == paFormatIsSupported)
+                return sampleRate;
+
+            const auto* deviceInfo = Pa_GetDeviceInfo(inputParameters.device);
+            if (deviceInfo && Pa_IsFormatSupported(&inputParameters, nullptr, deviceInfo->defaultSampleRate) == paFormatIsSupported)
+                return deviceInfo->defaultSampleRate;
+
+            return 0.0;
+        }
+
+        static bool closeStream(PaStream*& stream)
+        {
+            if (const auto err = Pa_StopStream(stream); err != paNoError) {
+                std::cerr << "PortAudio error stopping stream: " << Pa_GetErrorText(err) << std::endl;
+                return false;
+            }
+
+            if (const auto err = Pa_CloseStream(stream); err != paNoError) {
+                std::cerr << "PortAudio error closing stream: " << Pa_GetErrorText(err) << std::endl;
+                return false;
+            }
+
+            stream = nullptr;
+            return true;
+        }
+
+        // After a failed start: stops whatever did start and closes both streams, so the next
+        // start begins from nothing open. Errors are of no use to anyone here.
+        void discardStreams()
+        {
+            for (auto* stream : {&inputStream_, &stream_}) {
+                if (!*stream) continue;
+                if (Pa_IsStreamStopped(*stream) == 0)
+                    Pa_StopStream(*stream);
+                Pa_CloseStream(*stream);
+                *stream = nullptr;
+            }
+        }
+
         static bool validateStreamParameters(int inputDeviceIndex, int outputDeviceIndex, StreamParams &params)
         {
             const PaDeviceInfo* inputDeviceInfo = Pa_GetDeviceInfo(inputDeviceIndex);
@@ -167,6 +295,11 @@ namespace audio {
                 const auto ip = iParams.channelCount > 0 ? &iParams : nullptr;
                 const auto op = oParams.channelCount > 0 ? &oParams : nullptr;
 
+                // separate devices get separate streams, the input may run at its own rate
+                if (inputDeviceIndex != outputDeviceIndex)
+                    return getInputRate(iParams, params.sampleRate) > 0.0
+                        && Pa_IsFormatSupported(nullptr, op, params.sampleRate) == paFormatIsSupported;
+
                 if (const auto err = Pa_IsFormatSupported(ip, op, params.sampleRate); err == paFormatIsSupported) {
                     return true;
                 } else {
@@ -179,58 +312,22 @@ namespace audio {
 
         void scanDevices()
         {
+            devices_.clear();
+            scanned_ = true;
+
             for (int i = 0; i < Pa_GetHostApiCount(); ++i) {
                 const auto *hostApiInfo = Pa_GetHostApiInfo(i);
                 if (!hostApiInfo) continue;
 
-                //std::cout << "Host Api: " << hostApiInfo->name << std::endl;
-
                 for (int j = 0; j < hostApiInfo->deviceCount; ++j) {
                     const auto deviceIndex = Pa_HostApiDeviceIndexToDeviceIndex(i, j);
                     const auto deviceInfo = Pa_GetDeviceInfo(deviceIndex);
+                    if (!deviceInfo) continue;
 
-                    /*std::cout << "Device name:" << deviceInfo->name << std::endl;
-                    std::cout << "Max input channels: " << deviceInfo->maxInputChannels << std::endl;
-                    std::cout << "Max output channels: " << deviceInfo->maxOutputChannels << std::endl;
-                    std::cout << "Default Low Input Latency: " << deviceInfo->defaultLowInputLatency << std::endl;
-                    std::cout << "Default Low Output Latency: " << deviceInfo->defaultLowOutputLatency << std::endl;
-                    std::cout << "Default High Input Latency: " << deviceInfo->defaultHighInputLatency << std::endl;
-                    std::cout << "Default High Output Latency: " << deviceInfo->defaultHighOutputLatency << std::endl;
-                    std::cout << "Default Sample rate: " << deviceInfo->defaultSampleRate << std::endl;*/
-
-                    PaStreamParameters iParams;
-                    iParams.device = deviceIndex;
-                    iParams.channelCount = deviceInfo->maxInputChannels;
-                    iParams.sampleFormat = paFloat32;
-                    iParams.suggestedLatency = deviceInfo->defaultLowInputLatency;
-                    iParams.hostApiSpecificStreamInfo = nullptr;
-
-                    PaStreamParameters oParams;
-                    oParams.device = deviceIndex;
-                    oParams.channelCount = deviceInfo->maxOutputChannels;
-                    oParams.sampleFormat = paFloat32;
-                    oParams.suggestedLatency = deviceInfo->defaultLowOutputLatency;
-                    oParams.hostApiSpecificStreamInfo = nullptr;
-
-                    const auto ip = iParams.channelCount > 0 ? &iParams : nullptr;
-                    const auto op = oParams.channelCount > 0 ? &oParams : nullptr;
-
-                    std::vector<unsigned int> supportedSampleRates;
-
-                    for (const auto sr : {22050, 32000, 44100, 48000, 88200, 96000, 192000}) {
-                        if (const auto err = Pa_IsFormatSupported(ip, op, sr); err == paFormatIsSupported) {
-                            supportedSampleRates.push_back(static_cast<unsigned int>(sr));
-                        /*} else {
-                            std::cout << Pa_GetErrorText(err) << std::endl;*/
-                        }
-                    }
-
-                    /*std::cout << "Supported Sample Rates: ";
-                    for (const auto sr : supportedSampleRates) {
-                        std::cout << sr << " ";
-                    }
-
-                    std::cout << std::endl << std::endl;*/
+                    const auto key = DeviceCache::makeKey(hostApiInfo->name, deviceInfo->name,
+                                                          static_cast<unsigned int>(deviceInfo->maxInputChannels),
+                                                          static_cast<unsigned int>(deviceInfo->maxOutputChannels),
+                                                          deviceInfo->defaultSampleRate);
 
                     AudioDevice device;
                     device.deviceIndex = deviceIndex;
@@ -238,10 +335,50 @@ namespace audio {
                     device.hostApiName = hostApiInfo->name;
                     device.maxInputChannels = deviceInfo->maxInputChannels;
                     device.maxOutputChannels = deviceInfo->maxOutputChannels;
-                    device.supportedSampleRates = std::move(supportedSampleRates);
-                    devices_.emplace_back(device);
+                    device.isDefaultInput = deviceIndex == hostApiInfo->defaultInputDevice;
+                    device.isDefaultOutput = deviceIndex == hostApiInfo->defaultOutputDevice;
+
+                    if (const auto* cached = cache_.find(key)) {
+                        device.supportedSampleRates = *cached;
+                    } else {
+                        device.supportedSampleRates = probeSampleRates(deviceIndex, *deviceInfo);
+                        cache_.insert(key, device.supportedSampleRates);
+                    }
+
+                    devices_.emplace_back(std::move(device));
                 }
             }
+
+            cache_.save();
+        }
+
+        static std::vector<unsigned int> probeSampleRates(PaDeviceIndex deviceIndex, const PaDeviceInfo& deviceInfo)
+        {
+            PaStreamParameters iParams;
+            iParams.device = deviceIndex;
+            iParams.channelCount = deviceInfo.maxInputChannels;
+            iParams.sampleFormat = paFloat32;
+            iParams.suggestedLatency = deviceInfo.defaultLowInputLatency;
+            iParams.hostApiSpecificStreamInfo = nullptr;
+
+            PaStreamParameters oParams;
+            oParams.device = deviceIndex;
+            oParams.channelCount = deviceInfo.maxOutputChannels;
+            oParams.sampleFormat = paFloat32;
+            oParams.suggestedLatency = deviceInfo.defaultLowOutputLatency;
+            oParams.hostApiSpecificStreamInfo = nullptr;
+
+            const auto ip = iParams.channelCount > 0 ? &iParams : nullptr;
+            const auto op = oParams.channelCount > 0 ? &oParams : nullptr;
+
+            std::vector<unsigned int> supportedSampleRates;
+
+            for (const auto sr : {22050, 32000, 44100, 48000, 88200, 96000, 192000}) {
+                if (Pa_IsFormatSupported(ip, op, sr) == paFormatIsSupported)
+                    supportedSampleRates.push_back(static_cast<unsigned int>(sr));
+            }
+
+            return supportedSampleRates;
         }
 
         static int paCallback(const void *input,
@@ -265,9 +402,57 @@ namespace audio {
             return paContinue;
         }
 
+        static int paInputCallback(const void *input,
+                                   void *output,
+                                   unsigned long frameCount,
+                                   const PaStreamCallbackTimeInfo* timeInfo,
+                                   PaStreamCallbackFlags statusFlags,
+                                   void *userData)
+        {
+            (void) output;
+            (void) timeInfo;
+            (void) statusFlags;
+
+            auto *backend = static_cast<PortAudioBackend*>(userData);
+            backend->asyncInput_.write(static_cast<const float*>(input), static_cast<unsigned int>(frameCount), timestampNow());
+
+            return paContinue;
+        }
+
+        static int paOutputCallback(const void *input,
+                                    void *output,
+                                    unsigned long frameCount,
+                                    const PaStreamCallbackTimeInfo* timeInfo,
+                                    PaStreamCallbackFlags statusFlags,
+                                    void *userData)
+        {
+            (void) input;
+            (void) timeInfo;
+            (void) statusFlags;
+
+            auto *backend = static_cast<PortAudioBackend*>(userData);
+
+            auto* in = backend->inputScratch_.data();
+            auto out = static_cast<float*>(output);
+
+            backend->asyncInput_.read(in, static_cast<unsigned int>(frameCount), timestampNow());
+
+            if (!backend->audioCallback_(in, out, frameCount))
+                return paAbort;
+
+            return paContinue;
+        }
+
         PaStream* stream_{nullptr};
 
+        // only with separate input and output devices, stream_ is then the output stream
+        PaStream* inputStream_{nullptr};
+        AsyncInput asyncInput_;
+        std::vector<float> inputScratch_;
+
         std::vector<AudioDevice> devices_;
+        bool scanned_{false};
+        DeviceCache cache_;
     };
 
 } // audio
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "realtime_thread.h"
+
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE__) || defined(_M_X64)
+    #include <xmmintrin.h>
+#endif
+
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#elif defined(_WIN32)
+    #include <windows.h>
+#endif
+
+using namespace audio;
+
+static int setPriority(int priority) noexcept
+{
+#if defined(__linux__)
+    sched_param param{};
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#elif defined(_WIN32)
+    (void) priority;
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) ? 0 : static_cast<int>(GetLastError());
+#else
+    (void) priority;
+    return RealtimeErrors::UNSUPPORTED;
+#endif
+}
+
+static int setAffinity(int cpu) noexcept
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+    if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8))
+        return ERROR_INVALID_PARAMETER;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << cpu) ? 0 : static_cast<int>(GetLastError());
+#else
+    (void) cpu;
+    return RealtimeErrors::UNSUPPORTED;
+#endif
+}
+
+static std::string describeError(int err)
+{
+    if (err == RealtimeErrors::UNSUPPORTED)
+        return "not supported on this platform";
+#if defined(_WIN32)
+    return "error " + std::to_string(err);
+#else
+    return std::strerror(err);
+#endif
+}
+
+void audio::flushDenormalsToZero() noexcept
+{
+#if defined(__SSE__) || defined(_M_X64)
+    // FTZ (bit 15) and DAZ (bit 6) of MXCSR
+    _mm_setcsr(_mm_getcsr() | 0x8040);
+#elif defined(__aarch64__)
+    // FZ (bit 24) of FPCR, it covers inputs as well
+    std::uint64_t fpcr;
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+    asm volatile("msr fpcr, %0" : : "r"(fpcr | (std::uint64_t{1} << 24)));
+#endif
+}
+
+audio::RealtimeErrors audio::applyRealtimeSettings(const RealtimeSettings& settings) noexcept
+{
+    RealtimeErrors errors;
+    if (settings.cpu >= 0)
+        errors.affinity = setAffinity(settings.cpu);
+    if (settings.priority > 0)
+        errors.priority = setPriority(settings.priority);
+    return errors;
+}
+
+bool audio::reportRealtimeErrors(const RealtimeSettings& settings, const RealtimeErrors& errors)
+{
+    if (errors.affinity != 0)
+        std::cerr << "Failed to pin the audio thread to CPU " << settings.cpu << ": " << describeError(errors.affinity) << std::endl;
+
+    // EPERM without CAP_SYS_NICE or an rtprio limit (/etc/security/limits.d)
+    if (errors.priority != 0)
+        std::cerr << "Failed to set the audio thread's real-time priority " << settings.priority << ": "
+                  << describeError(errors.priority) << std::endl;
+
+    return errors.affinity == 0 && errors.priority == 0;
+}
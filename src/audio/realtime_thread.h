@@ -0,0 +1,36 @@
+#pragma once
+
+namespace audio {
+
+    struct RealtimeSettings
+    {
+        // SCHED_FIFO priority (1-99), 0 leaves the scheduling as the backend set it up
+        int priority{0};
+        // CPU the audio thread is pinned to, -1 lets it migrate
+        int cpu{-1};
+        // mlockall() once the stream's buffers are allocated
+        bool lockMemory{false};
+    };
+
+    // Outcome of applyRealtimeSettings() per setting: 0 where it worked or was not asked for,
+    // otherwise the error code (errno, GetLastError() on Windows) or UNSUPPORTED
+    struct RealtimeErrors
+    {
+        static constexpr int UNSUPPORTED = -1;
+        int affinity{0};
+        int priority{0};
+    };
+
+    // Applies settings to the calling thread, meant for the audio thread before it processes
+    // anything. Prints nothing: failures leave the thread as is and are returned, for another
+    // thread to pass to reportRealtimeErrors().
+    RealtimeErrors applyRealtimeSettings(const RealtimeSettings& settings) noexcept;
+
+    // Not real-time safe. Prints the failures on stderr, false if there were any.
+    bool reportRealtimeErrors(const RealtimeSettings& settings, const RealtimeErrors& errors);
+
+    // Flushes denormals to zero (FTZ/DAZ) on the calling thread. Decaying feedback paths (Faust
+    // reverbs, filters) otherwise slow down by orders of magnitude once they fade out.
+    void flushDenormalsToZero() noexcept;
+
+}
@@ -0,0 +1,231 @@
+#include "command_server.h"
+
+#include <charconv>
+#include <iostream>
+#include <vector>
+
+#if !defined(_WIN32)
+    #include <csignal>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+#include "timestamp.h"
+
+using namespace cli;
+
+static constexpr int POLL_TIMEOUT_MS = 100;
+
+static std::string_view trim(std::string_view text)
+{
+    const auto first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string_view::npos) return {};
+    const auto last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+std::optional<looper::LooperCommand> cli::parseCommand(std::string_view line)
+{
+    line = trim(line);
+    const auto space = line.find(' ');
+    const auto name = line.substr(0, space);
+    const auto argument = space == std::string_view::npos ? std::string_view{} : trim(line.substr(space + 1));
+
+    if (name == "rec" || name == "record") return looper::LooperCommand::startRecording();
+    if (name == "stop") return looper::LooperCommand::stopRecording();
+    if (name == "clear") return looper::LooperCommand::clear();
+    if (name == "undo") return looper::LooperCommand::undo();
+    if (name == "redo") return looper::LooperCommand::redo();
+    if (name == "reverse") return looper::LooperCommand::toggleReverse();
+    if (name == "tempo" || name == "speed") {
+        auto value = 0.0;
+        const auto* end = argument.data() + argument.size();
+        const auto result = std::from_chars(argument.data(), end, value);
+        if (result.ec != std::errc() || result.ptr != end) return std::nullopt;
+        return name == "tempo" ? looper::LooperCommand::setTempo(value) : looper::LooperCommand::setSpeed(value);
+    }
+    if (name == "interp") {
+        if (argument == "linear") return looper::LooperCommand::setInterpolation(looper::Interpolation::LINEAR);
+        if (argument == "cubic") return looper::LooperCommand::setInterpolation(looper::Interpolation::CUBIC);
+        if (argument == "sinc") return looper::LooperCommand::setInterpolation(looper::Interpolation::SINC);
+        return std::nullopt;
+    }
+
+    return std::nullopt;
+}
+
+CommandServer::CommandServer(looper::LooperMailbox& commands)
+    : commands_(commands)
+{}
+
+CommandServer::~CommandServer()
+{
+    stop();
+}
+
+bool CommandServer::start(bool readStdin, const std::string& socketPath)
+{
+    if (running_.load(std::memory_order_relaxed)) return false;
+
+    readStdin_ = readStdin;
+    socketPath_ = socketPath;
+
+    if (!socketPath_.empty()) {
+#if defined(_WIN32)
+        std::cerr << "Command sockets are not supported on this platform" << std::endl;
+        return false;
+#else
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socketPath_.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Socket path too long: " << socketPath_ << std::endl;
+            return false;
+        }
+        socketPath_.copy(address.sun_path, socketPath_.size());
+
+        listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ::unlink(socketPath_.c_str());
+        if (listenFd_ < 0
+            || ::bind(listenFd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+            || ::listen(listenFd_, 4) != 0) {
+            std::cerr << "Failed to listen on " << socketPath_ << std::endl;
+            if (listenFd_ >= 0) ::close(listenFd_);
+            listenFd_ = -1;
+            return false;
+        }
+        // replies to clients that already hung up must not kill the process
+        std::signal(SIGPIPE, SIG_IGN);
+        std::cout << "Listening for commands on " << socketPath_ << std::endl;
+#endif
+    }
+
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread([this] { threadLoop(); });
+    return true;
+}
+
+void CommandServer::stop()
+{
+    if (!running_.exchange(false, std::memory_order_acq_rel)) return;
+
+#if defined(_WIN32)
+    // blocked in std::getline, it ends with the process
+    thread_.detach();
+#else
+    thread_.join();
+    if (listenFd_ >= 0) {
+        ::close(listenFd_);
+        ::unlink(socketPath_.c_str());
+        listenFd_ = -1;
+    }
+#endif
+}
+
+bool CommandServer::quitRequested() const noexcept
+{
+    return quit_.load(std::memory_order_acquire);
+}
+
+std::string CommandServer::handleLine(std::string_view line)
+{
+    line = trim(line);
+    if (line.empty()) return {};
+
+    if (line == "quit" || line == "exit") {
+        quit_.store(true, std::memory_order_release);
+        return "ok\n";
+    }
+
+    auto command = parseCommand(line);
+    if (!command) return "error: unknown command\n";
+
+    if (!commands_.tryPush(command->at(timestampNow())))
+        return "error: looper mailbox full\n";
+    return "ok\n";
+}
+
+#if defined(_WIN32)
+
+void CommandServer::threadLoop()
+{
+    std::string line;
+    while (readStdin_ && running_.load(std::memory_order_acquire) && std::getline(std::cin, line))
+        std::cout << handleLine(line) << std::flush;
+}
+
+#else
+
+void CommandServer::threadLoop()
+{
+    struct Source
+    {
+        int fd{-1};
+        int replyFd{-1};
+        std::string pending;
+    };
+
+    std::vector<Source> sources;
+    if (readStdin_)
+        sources.push_back(Source{STDIN_FILENO, STDOUT_FILENO, {}});
+
+    std::vector<pollfd> fds;
+    char buffer[512];
+
+    while (running_.load(std::memory_order_acquire)) {
+        fds.clear();
+        if (listenFd_ >= 0)
+            fds.push_back(pollfd{listenFd_, POLLIN, 0});
+        for (const auto& source : sources)
+            fds.push_back(pollfd{source.fd, POLLIN, 0});
+
+        if (fds.empty() || ::poll(fds.data(), fds.size(), POLL_TIMEOUT_MS) <= 0) {
+            if (fds.empty()) ::usleep(POLL_TIMEOUT_MS * 1000);
+            continue;
+        }
+
+        auto index = 0u;
+        if (listenFd_ >= 0) {
+            if (fds[index].revents & POLLIN) {
+                const auto client = ::accept(listenFd_, nullptr, nullptr);
+                if (client >= 0)
+                    sources.push_back(Source{client, client, {}});
+            }
+            ++index;
+        }
+
+        // sources accepted above were not polled yet, they start after the polled ones
+        const auto numPolled = fds.size() - index;
+        for (auto s{0u}; s < numPolled; ++s) {
+            auto& source = sources[s];
+            if (!(fds[index + s].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+            const auto received = ::read(source.fd, buffer, sizeof(buffer));
+            if (received <= 0) {
+                // stdin ends or a client disconnects, the other sources stay
+                if (source.fd != STDIN_FILENO) ::close(source.fd);
+                source.fd = -1;
+                continue;
+            }
+
+            source.pending.append(buffer, static_cast<std::size_t>(received));
+            std::size_t newline;
+            while ((newline = source.pending.find('\n')) != std::string::npos) {
+                const auto reply = handleLine(std::string_view(source.pending).substr(0, newline));
+                source.pending.erase(0, newline + 1);
+                if (!reply.empty()) {
+                    [[maybe_unused]] const auto written = ::write(source.replyFd, reply.data(), reply.size());
+                }
+            }
+        }
+
+        std::erase_if(sources, [](const Source& source) { return source.fd < 0; });
+    }
+
+    for (const auto& source : sources) {
+        if (source.fd != STDIN_FILENO) ::close(source.fd);
+    }
+}
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "looper/looper_commands.h"
+
+namespace cli {
+
+// "rec", "stop", "clear" or "tempo <bpm>"
+std::optional<looper::LooperCommand> parseCommand(std::string_view line);
+
+// Text commands for headless mode, one per line from stdin and/or clients of a local
+// (unix domain) socket. A single thread serves all sources, so it is the only producer of the
+// looper mailbox. "quit" sets quitRequested().
+class CommandServer
+{
+public:
+    explicit CommandServer(looper::LooperMailbox& commands);
+    ~CommandServer();
+
+    CommandServer(const CommandServer&) = delete;
+    CommandServer& operator=(const CommandServer&) = delete;
+
+    bool start(bool readStdin, const std::string& socketPath);
+    void stop();
+
+    bool quitRequested() const noexcept;
+
+private:
+    void threadLoop();
+    // returns the reply for the sender
+    std::string handleLine(std::string_view line);
+
+    looper::LooperMailbox& commands_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> quit_{false};
+
+    bool readStdin_{false};
+    std::string socketPath_;
+    int listenFd_{-1};
+};
+
+} // namespace cli
@@ -0,0 +1,132 @@
+#include "offline_render.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "command_server.h"
+#include "fx/resampler.h"
+#include "wav_file.h"
+
+using namespace cli;
+
+struct ScheduledCommand
+{
+    unsigned long long frame{0};
+    looper::LooperCommand command;
+};
+
+static bool readSchedule(const std::string& path, unsigned int sampleRate, std::vector<ScheduledCommand>& schedule)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open command file " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    auto lineNumber = 0u;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        auto text = std::string_view(line);
+        text = text.substr(0, text.find('#'));
+        const auto first = text.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos) continue;
+        text = text.substr(first);
+
+        auto seconds = 0.0;
+        const auto result = std::from_chars(text.data(), text.data() + text.size(), seconds);
+        const auto command = result.ec == std::errc() ? parseCommand(std::string_view(result.ptr, text.data() + text.size() - result.ptr)) : std::nullopt;
+        if (!command || seconds < 0.0) {
+            std::cerr << path << ":" << lineNumber << ": expected \"<seconds> <command>\"" << std::endl;
+            return false;
+        }
+
+        schedule.push_back(ScheduledCommand{static_cast<unsigned long long>(std::llround(seconds * sampleRate)), *command});
+    }
+
+    std::ranges::stable_sort(schedule, {}, &ScheduledCommand::frame);
+    return true;
+}
+
+bool cli::renderOffline(audio::AudioCallback& callback, looper::LooperMailbox& commands, const Options& options)
+{
+    AudioFile input;
+    if (!readWav(options.renderInput, input))
+        return false;
+
+    if (options.renderRate > 0 && options.renderRate != input.sampleRate) {
+        input.channels = fx::resample(input.channels, input.sampleRate, options.renderRate, fx::Resampler::Quality::BEST);
+        input.sampleRate = options.renderRate;
+    }
+
+    auto& engine = audio::AudioEngine::getInstance();
+    engine.setSampleRate(input.sampleRate);
+
+    // same float arithmetic as on the audio thread, so renders match what plays live
+    audio::flushDenormalsToZero();
+
+    std::vector<ScheduledCommand> schedule;
+    if (!options.renderCommands.empty() && !readSchedule(options.renderCommands, input.sampleRate, schedule))
+        return false;
+
+    const auto numInputs = engine.getNumInputChannels();
+    const auto numOutputs = engine.getNumOutputChannels();
+    const auto blockSize = std::min(options.bufferSize, audio::AudioEngine::MAX_FRAMES_IN_BUFFER);
+    const auto length = options.renderSeconds > 0.0
+        ? static_cast<unsigned long long>(std::llround(options.renderSeconds * input.sampleRate))
+        : input.getNumFrames();
+
+    AudioFile output;
+    output.sampleRate = input.sampleRate;
+    output.channels.assign(numOutputs, std::vector<float>(length, 0.0f));
+
+    std::vector<std::vector<float>> inBuffers(numInputs, std::vector<float>(blockSize));
+    std::vector<std::vector<float>> outBuffers(numOutputs, std::vector<float>(blockSize));
+    std::vector<float*> in(numInputs);
+    std::vector<float*> out(numOutputs);
+    for (auto c{0u}; c < numInputs; ++c) in[c] = inBuffers[c].data();
+    for (auto c{0u}; c < numOutputs; ++c) out[c] = outBuffers[c].data();
+
+    callback.onStart();
+
+    auto next = schedule.begin();
+    for (unsigned long long frame = 0; frame < length;) {
+        // commands are consumed at the start of a block, so blocks end where a command is due
+        while (next != schedule.end() && next->frame <= frame) {
+            if (!commands.tryPush(next->command)) break;
+            ++next;
+        }
+
+        auto n = static_cast<unsigned int>(std::min<unsigned long long>(blockSize, length - frame));
+        if (next != schedule.end() && next->frame > frame)
+            n = static_cast<unsigned int>(std::min<unsigned long long>(n, next->frame - frame));
+
+        // mono files feed every input channel, extra file channels are dropped
+        for (auto c{0u}; c < numInputs; ++c) {
+            const auto& source = input.channels[std::min(c, input.getNumChannels() - 1)];
+            for (auto i{0u}; i < n; ++i)
+                inBuffers[c][i] = frame + i < source.size() ? source[frame + i] : 0.0f;
+        }
+        for (auto& buffer : outBuffers)
+            std::fill_n(buffer.begin(), n, 0.0f);
+
+        callback.onProcess(in.data(), out.data(), n);
+
+        for (auto c{0u}; c < numOutputs; ++c)
+            std::copy_n(outBuffers[c].begin(), n, output.channels[c].begin() + static_cast<std::ptrdiff_t>(frame));
+        frame += n;
+    }
+
+    callback.onStop();
+
+    if (!writeWav(options.renderOutput, output))
+        return false;
+
+    std::cout << "Rendered " << length << " frames to " << options.renderOutput << std::endl;
+    return true;
+}
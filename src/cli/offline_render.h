@@ -0,0 +1,15 @@
+#pragma once
+
+#include "audio/audio_engine.h"
+#include "looper/looper_commands.h"
+
+#include "options.h"
+
+namespace cli {
+
+// Runs options.renderInput through callback as fast as possible, without an audio device, and
+// writes the output to options.renderOutput. Commands from options.renderCommands
+// ("<seconds> <command>" per line) are pushed to commands and take effect on their exact frame.
+bool renderOffline(audio::AudioCallback& callback, looper::LooperMailbox& commands, const Options& options);
+
+} // namespace cli
@@ -0,0 +1,164 @@
+#include "options.h"
+
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+using namespace cli;
+
+static bool isFlag(std::string_view key)
+{
+    return key == "headless" || key == "list-devices" || key == "no-stdin" || key == "rescan-devices" || key == "lock-memory" || key == "help";
+}
+
+template <typename T>
+static bool parseNumber(std::string_view text, T& value)
+{
+    const auto* end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+static bool parseSwitch(std::string_view text)
+{
+    return text.empty() || text == "1" || text == "true" || text == "yes" || text == "on";
+}
+
+static std::string_view trim(std::string_view text)
+{
+    const auto first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) return {};
+    const auto last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// a device is an index or, when it is not a number, a name
+static void parseDevice(std::string_view value, int& index, std::string& name)
+{
+    index = -1;
+    name.clear();
+    if (!parseNumber(value, index))
+        name = value;
+}
+
+static bool readConfig(const std::string& path, Options& options);
+
+static bool applyOption(std::string_view key, std::string_view value, Options& options)
+{
+    auto ok = true;
+
+    if (key == "headless") options.headless = parseSwitch(value);
+    else if (key == "list-devices") options.listDevices = parseSwitch(value);
+    else if (key == "no-stdin") options.stdinCommands = !parseSwitch(value);
+    else if (key == "help") options.help = parseSwitch(value);
+    else if (key == "rescan-devices") options.rescanDevices = parseSwitch(value);
+    else if (key == "lock-memory") options.lockMemory = parseSwitch(value);
+    else if (key == "input-device") parseDevice(value, options.inputDevice, options.inputDeviceName);
+    else if (key == "output-device") parseDevice(value, options.outputDevice, options.outputDeviceName);
+    else if (key == "host-api") options.hostApi = value;
+    else if (key == "device-cache") options.deviceCachePath = value;
+    else if (key == "sample-rate") ok = parseNumber(value, options.sampleRate) && options.sampleRate > 0;
+    else if (key == "buffer-size") ok = parseNumber(value, options.bufferSize) && options.bufferSize > 0;
+    else if (key == "rt-priority") ok = parseNumber(value, options.rtPriority) && options.rtPriority >= 0 && options.rtPriority <= 99;
+    else if (key == "rt-cpu") ok = parseNumber(value, options.rtCpu) && options.rtCpu >= 0;
+    else if (key == "fade-ms") ok = parseNumber(value, options.fadeMs) && options.fadeMs >= 0.0 && options.fadeMs <= 100.0;
+    else if (key == "beats-per-bar") ok = parseNumber(value, options.beatsPerBar) && options.beatsPerBar >= 1 && options.beatsPerBar <= 32;
+    else if (key == "socket") options.socketPath = value;
+    else if (key == "render") options.renderInput = value;
+    else if (key == "output") options.renderOutput = value;
+    else if (key == "commands") options.renderCommands = value;
+    else if (key == "render-rate") ok = parseNumber(value, options.renderRate);
+    else if (key == "length") ok = parseNumber(value, options.renderSeconds) && options.renderSeconds >= 0.0;
+    else if (key == "config") ok = readConfig(std::string(value), options);
+    else {
+        std::cerr << "Unknown option: " << key << std::endl;
+        return false;
+    }
+
+    if (!ok)
+        std::cerr << "Invalid value for " << key << ": " << value << std::endl;
+    return ok;
+}
+
+static bool readConfig(const std::string& path, Options& options)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open config file " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        auto text = std::string_view(line);
+        text = trim(text.substr(0, text.find('#')));
+        if (text.empty()) continue;
+
+        const auto equals = text.find('=');
+        const auto key = trim(text.substr(0, equals));
+        const auto value = equals == std::string_view::npos ? std::string_view{} : trim(text.substr(equals + 1));
+        if (key == "config" || !applyOption(key, value, options))
+            return false;
+    }
+
+    return true;
+}
+
+bool cli::parseOptions(int argc, char** argv, Options& options)
+{
+    for (auto i{1}; i < argc; ++i) {
+        const auto argument = std::string_view(argv[i]);
+        if (!argument.starts_with("--")) {
+            std::cerr << "Unexpected argument: " << argument << std::endl;
+            return false;
+        }
+
+        const auto key = argument.substr(2);
+        if (isFlag(key)) {
+            if (!applyOption(key, {}, options)) return false;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << argument << std::endl;
+            return false;
+        }
+        if (!applyOption(key, argv[++i], options)) return false;
+    }
+
+    if (options.renderInput.empty() != options.renderOutput.empty()) {
+        std::cerr << "--render and --output must be given together" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void cli::printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --config <file>        read options from \"key = value\" lines\n"
+              << "  --list-devices         print the audio devices and exit\n"
+              << "  --input-device <n>     input device index (-1 for the default) or name\n"
+              << "  --output-device <n>    output device index (-1 for the default) or name\n"
+              << "  --host-api <name>      prefer devices of this host API, e.g. ALSA, JACK, WASAPI\n"
+              << "  --device-cache <file>  probed device capabilities, \"\" to always probe\n"
+              << "  --rescan-devices       probe the devices again and refresh the cache\n"
+              << "  --sample-rate <hz>     default 48000\n"
+              << "  --buffer-size <frames> default 64\n"
+              << "  --rt-priority <1-99>   SCHED_FIFO priority of the audio thread\n"
+              << "  --rt-cpu <n>           pin the audio thread to this CPU\n"
+              << "  --lock-memory          mlockall() once the buffers are allocated\n"
+              << "  --fade-ms <ms>         punch-in/out and loop seam fades, default 5, 0 cuts hard\n"
+              << "  --beats-per-bar <n>    bar length the first recording is rounded to, default 4\n"
+              << "  --headless             run without a window, commands from stdin/socket\n"
+              << "  --no-stdin             headless: do not read commands from stdin\n"
+              << "  --socket <path>        headless: also accept commands on a local socket\n"
+              << "  --render <in.wav>      render offline at full speed, needs --output\n"
+              << "  --output <out.wav>     offline render destination (32-bit float)\n"
+              << "  --commands <file>      offline render: \"<seconds> <command>\" lines\n"
+              << "  --length <seconds>     offline render length, default the input length\n"
+              << "  --render-rate <hz>     offline render: convert the input to this rate first\n"
+              << "Commands: rec, stop, clear, undo, redo, tempo <bpm>, speed <ratio>, reverse, interp <linear|cubic|sinc>, quit" << std::endl;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+
+namespace cli {
+
+struct Options
+{
+    bool headless{false};
+    bool listDevices{false};
+    bool help{false};
+
+    // -1 picks the default device, without any selection the window mode asks on stdin.
+    // Devices can also be given by name, optionally narrowed down to a host API.
+    int inputDevice{-1};
+    int outputDevice{-1};
+    std::string inputDeviceName;
+    std::string outputDeviceName;
+    std::string hostApi;
+
+    // probed device capabilities, empty disables the cache
+    std::string deviceCachePath;
+    bool rescanDevices{false};
+    unsigned int sampleRate{48000};
+    unsigned int bufferSize{64};
+
+    // audio thread scheduling, 0 / -1 leave it to the backend
+    int rtPriority{0};
+    int rtCpu{-1};
+    bool lockMemory{false};
+
+    // punch-in/out and loop seam fades, 0 cuts hard
+    double fadeMs{5.0};
+    // with a tempo the first recording is rounded to whole bars of this many beats
+    unsigned int beatsPerBar{4};
+
+    // headless command sources
+    bool stdinCommands{true};
+    std::string socketPath;
+
+    // offline rendering, input file to output file without an audio device
+    std::string renderInput;
+    std::string renderOutput;
+    std::string renderCommands;
+    double renderSeconds{0.0};
+    // 0 renders at the input file's rate
+    unsigned int renderRate{0};
+
+    bool hasDeviceSelection() const noexcept
+    {
+        return inputDevice >= 0 || outputDevice >= 0 || !inputDeviceName.empty() || !outputDeviceName.empty() || !hostApi.empty();
+    }
+};
+
+// Parses "--key value" and "--flag" arguments. "--config <file>" reads the same keys from
+// "key = value" lines (# starts a comment), arguments after it override the file.
+bool parseOptions(int argc, char** argv, Options& options);
+void printUsage(const char* program);
+
+} // namespace cli
@@ -0,0 +1,159 @@
+#include "wav_file.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace cli;
+
+static constexpr std::uint16_t FORMAT_PCM = 1;
+static constexpr std::uint16_t FORMAT_FLOAT = 3;
+static constexpr std::uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+
+// WAV is little endian, assemble values byte by byte to stay independent of the host
+static std::uint32_t readLe(const unsigned char* bytes, unsigned int numBytes)
+{
+    std::uint32_t value = 0;
+    for (auto i{0u}; i < numBytes; ++i)
+        value |= static_cast<std::uint32_t>(bytes[i]) << (8 * i);
+    return value;
+}
+
+static void writeLe(std::ofstream& out, std::uint32_t value, unsigned int numBytes)
+{
+    for (auto i{0u}; i < numBytes; ++i)
+        out.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+static float decodeSample(const unsigned char* bytes, std::uint16_t format, unsigned int bytesPerSample)
+{
+    if (format == FORMAT_FLOAT) {
+        if (bytesPerSample == 4) {
+            const auto bits = readLe(bytes, 4);
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        const auto bits = static_cast<std::uint64_t>(readLe(bytes, 4)) | static_cast<std::uint64_t>(readLe(bytes + 4, 4)) << 32;
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return static_cast<float>(value);
+    }
+
+    // 8-bit PCM is unsigned, wider formats are two's complement
+    if (bytesPerSample == 1)
+        return (static_cast<float>(bytes[0]) - 128.0f) / 128.0f;
+
+    const auto bits = bytesPerSample * 8;
+    const auto raw = readLe(bytes, bytesPerSample) << (32 - bits);
+    return static_cast<float>(static_cast<std::int32_t>(raw)) / 2147483648.0f;
+}
+
+bool cli::readWav(const std::string& path, AudioFile& file)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+
+    unsigned char header[12];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header))
+        || std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0) {
+        std::cerr << path << " is not a WAV file" << std::endl;
+        return false;
+    }
+
+    std::uint16_t format = 0;
+    unsigned int numChannels = 0;
+    unsigned int bitsPerSample = 0;
+    unsigned int blockAlign = 0;
+    file.sampleRate = 0;
+
+    unsigned char chunk[8];
+    while (in.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+        const auto size = readLe(chunk + 4, 4);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            std::vector<unsigned char> fmt(size);
+            if (size < 16 || !in.read(reinterpret_cast<char*>(fmt.data()), size)) break;
+
+            format = static_cast<std::uint16_t>(readLe(fmt.data(), 2));
+            numChannels = readLe(fmt.data() + 2, 2);
+            file.sampleRate = readLe(fmt.data() + 4, 4);
+            blockAlign = readLe(fmt.data() + 12, 2);
+            bitsPerSample = readLe(fmt.data() + 14, 2);
+
+            // the actual format is the first two bytes of the sub format GUID
+            if (format == FORMAT_EXTENSIBLE && size >= 26)
+                format = static_cast<std::uint16_t>(readLe(fmt.data() + 24, 2));
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            const auto bytesPerSample = bitsPerSample / 8;
+            const auto supported = (format == FORMAT_PCM && bytesPerSample >= 1 && bytesPerSample <= 4)
+                || (format == FORMAT_FLOAT && (bytesPerSample == 4 || bytesPerSample == 8));
+            if (!supported || numChannels == 0 || blockAlign < numChannels * bytesPerSample) {
+                std::cerr << path << ": unsupported sample format" << std::endl;
+                return false;
+            }
+
+            std::vector<unsigned char> data(size);
+            in.read(reinterpret_cast<char*>(data.data()), size);
+            const auto numFrames = static_cast<unsigned int>(in.gcount()) / blockAlign;
+
+            file.channels.assign(numChannels, std::vector<float>(numFrames));
+            for (auto i{0u}; i < numFrames; ++i) {
+                for (auto c{0u}; c < numChannels; ++c)
+                    file.channels[c][i] = decodeSample(data.data() + i * blockAlign + c * bytesPerSample, format, bytesPerSample);
+            }
+            return true;
+        } else {
+            in.seekg(size + (size & 1), std::ios::cur);
+        }
+    }
+
+    std::cerr << path << ": no audio data found" << std::endl;
+    return false;
+}
+
+bool cli::writeWav(const std::string& path, const AudioFile& file)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+
+    const auto numChannels = file.getNumChannels();
+    const auto numFrames = file.getNumFrames();
+    const auto dataSize = numFrames * numChannels * 4u;
+
+    out.write("RIFF", 4);
+    writeLe(out, 36 + dataSize, 4);
+    out.write("WAVE", 4);
+
+    out.write("fmt ", 4);
+    writeLe(out, 16, 4);
+    writeLe(out, FORMAT_FLOAT, 2);
+    writeLe(out, numChannels, 2);
+    writeLe(out, file.sampleRate, 4);
+    writeLe(out, file.sampleRate * numChannels * 4, 4);
+    writeLe(out, numChannels * 4, 2);
+    writeLe(out, 32, 2);
+
+    out.write("data", 4);
+    writeLe(out, dataSize, 4);
+    for (auto i{0u}; i < numFrames; ++i) {
+        for (auto c{0u}; c < numChannels; ++c) {
+            std::uint32_t bits;
+            std::memcpy(&bits, &file.channels[c][i], sizeof(bits));
+            writeLe(out, bits, 4);
+        }
+    }
+
+    if (!out) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace cli {
+
+struct AudioFile
+{
+    unsigned int sampleRate{0};
+    std::vector<std::vector<float>> channels;
+
+    unsigned int getNumChannels() const noexcept { return static_cast<unsigned int>(channels.size()); }
+    unsigned int getNumFrames() const noexcept { return channels.empty() ? 0 : static_cast<unsigned int>(channels.front().size()); }
+};
+
+// Reads 16/24/32-bit integer PCM and 32/64-bit float WAV files (also WAVE_FORMAT_EXTENSIBLE)
+bool readWav(const std::string& path, AudioFile& file);
+
+// Writes 32-bit float WAV
+bool writeWav(const std::string& path, const AudioFile& file);
+
+} // namespace cli
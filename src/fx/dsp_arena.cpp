@@ -0,0 +1,50 @@
+#include "dsp_arena.h"
+
+using namespace fx;
+
+DspArena::DspArena(std::size_t capacity, bool hugePages)
+    : block_(memory::allocatePages(alignUp(capacity), hugePages))
+{
+    if (capacity > 0 && !block_.data)
+        throw std::bad_alloc();
+
+    // fresh pages fault on first touch, which would be the first process call
+    memory::prefault(block_.data, block_.size);
+    locked_ = memory::lockPages(block_.data, block_.size);
+    capacity_ = block_.size;
+}
+
+DspArena::~DspArena()
+{
+    // unmapping unlocks the pages as well
+    memory::freePages(block_);
+}
+
+void* DspArena::allocate(std::size_t size)
+{
+    const auto aligned = alignUp(size);
+
+    auto offset = offset_.load(std::memory_order_relaxed);
+    do {
+        if (aligned > capacity_ - offset)
+            throw std::bad_alloc();
+    } while (!offset_.compare_exchange_weak(offset, offset + aligned, std::memory_order_relaxed));
+
+    return static_cast<std::byte*>(block_.data) + offset;
+}
+
+void DspArena::destroy(void*)
+{
+    // blocks are only released all together in reset()
+}
+
+void DspArena::reset() noexcept
+{
+    offset_.store(0, std::memory_order_relaxed);
+}
+
+std::size_t DspArena::capacity() const noexcept { return capacity_; }
+std::size_t DspArena::used() const noexcept { return offset_.load(std::memory_order_relaxed); }
+bool DspArena::usesHugePages() const noexcept { return block_.hugePages; }
+bool DspArena::isLocked() const noexcept { return locked_; }
+void* DspArena::data() const noexcept { return block_.data; }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+#include <faust/faustMinimalInlined.h>
+
+#include "memory/page_memory.h"
+
+namespace fx {
+
+// Lock-free bump allocator handing out cache line aligned blocks from one contiguous,
+// page backed (optionally huge page) buffer, prefaulted and locked in RAM when it is
+// allocated. Individual blocks are never freed, the whole
+// arena is recycled at once with reset() when a chain is rebuilt.
+class DspArena final : public dsp_memory_manager
+{
+public:
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    explicit DspArena(std::size_t capacity, bool hugePages = false);
+    ~DspArena() override;
+
+    DspArena(const DspArena&) = delete;
+    DspArena& operator=(const DspArena&) = delete;
+
+    void* allocate(std::size_t size) override;
+    void destroy(void* ptr) override;
+
+    // Only valid once every object placed in the arena has been destroyed
+    void reset() noexcept;
+
+    std::size_t capacity() const noexcept;
+    std::size_t used() const noexcept;
+    bool usesHugePages() const noexcept;
+    bool isLocked() const noexcept;
+    void* data() const noexcept;
+
+    static constexpr std::size_t alignUp(std::size_t size) noexcept
+    {
+        return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    // Memory layout pass: runs the allocation path of DSP (classInit, construction and,
+    // for classes generated with -mem, memoryCreate) against a counting manager and
+    // returns the arena size needed for numInstances of it.
+    template <typename DSP>
+    static std::size_t measure(unsigned int numInstances, int sampleRate);
+
+private:
+    class CountingManager final : public dsp_memory_manager
+    {
+    public:
+        void* allocate(std::size_t size) override
+        {
+            total += alignUp(size);
+            return ::operator new(alignUp(size), std::align_val_t{ALIGNMENT});
+        }
+
+        void destroy(void* ptr) override
+        {
+            ::operator delete(ptr, std::align_val_t{ALIGNMENT});
+        }
+
+        std::size_t total{0};
+    };
+
+    memory::PageBlock block_;
+    std::size_t capacity_{0};
+    bool locked_{false};
+    std::atomic<std::size_t> offset_{0};
+};
+
+template <typename DSP>
+std::size_t DspArena::measure(unsigned int numInstances, int sampleRate)
+{
+    std::size_t staticBytes = 0;
+    std::size_t instanceBytes = alignUp(sizeof(DSP));
+
+    if constexpr (requires { DSP::fManager; }) {
+        CountingManager counter;
+        DSP::fManager = &counter;
+
+        DSP::classInit(sampleRate);
+        staticBytes = counter.total;
+
+        auto* instance = new (counter.allocate(sizeof(DSP))) DSP();
+        if constexpr (requires { instance->memoryCreate(); })
+            instance->memoryCreate();
+        instanceBytes = counter.total - staticBytes;
+
+        if constexpr (requires { instance->memoryDestroy(); })
+            instance->memoryDestroy();
+        instance->~DSP();
+        counter.destroy(instance);
+
+        if constexpr (requires { DSP::classDestroy(); })
+            DSP::classDestroy();
+
+        DSP::fManager = nullptr;
+    }
+
+    return staticBytes + numInstances * instanceBytes;
+}
+
+} // namespace fx
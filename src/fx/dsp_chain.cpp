@@ -0,0 +1,208 @@
+#include "dsp_chain.h"
+#include "latency.h"
+#include "parameter_table.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+using namespace fx;
+
+DspChain::DspChain(unsigned int numChannels, unsigned int maxFrames)
+    : numChannels_(numChannels), maxFrames_(maxFrames)
+{
+    scratch_.resize(numChannels_);
+    scratchPtrs_.resize(numChannels_);
+    dataPtrs_.resize(numChannels_);
+
+    for (auto c{0u}; c < numChannels_; ++c) {
+        scratch_[c].resize(maxFrames_);
+        scratchPtrs_[c] = scratch_[c].data();
+    }
+}
+
+DspChain::~DspChain()
+{
+    destroyArenaStages();
+}
+
+bool DspChain::checkChannels(int nIn, int nOut, Stage& stage) const
+{
+    if (nIn != nOut || nIn <= 0 || (nIn != 1 && nIn != static_cast<int>(numChannels_))) {
+        std::cerr << "DspChain: unsupported stage with " << nIn << " inputs and "
+                  << nOut << " outputs for " << numChannels_ << " channels" << std::endl;
+        return false;
+    }
+
+    stage.channelsPerInstance = static_cast<unsigned int>(nIn);
+    return true;
+}
+
+bool DspChain::addStage(std::unique_ptr<dsp> stage)
+{
+    if (!stage) return false;
+
+    Stage s;
+    if (!checkChannels(stage->getNumInputs(), stage->getNumOutputs(), s))
+        return false;
+
+    const auto numInstances = numChannels_ / s.channelsPerInstance;
+    for (auto i{1u}; i < numInstances; ++i)
+        s.owned.emplace_back(stage->clone());
+    s.owned.insert(s.owned.begin(), std::move(stage));
+
+    for (auto& instance : s.owned)
+        s.instances.push_back(instance.get());
+
+    stages_.push_back(std::move(s));
+    return true;
+}
+
+void DspChain::bindParameter(unsigned int slot, const std::string& path)
+{
+    requestedBindings_.emplace_back(slot, path);
+}
+
+void DspChain::bindParameters()
+{
+    bindings_.clear();
+
+    for (const auto& [slot, path] : requestedBindings_) {
+        bool found = false;
+
+        for (auto& stage : stages_) {
+            for (auto* instance : stage.instances) {
+                MapUI ui;
+                instance->buildUserInterface(&ui);
+                for (const auto& [address, zone] : ui.getMap()) {
+                    if (address.size() >= path.size() && address.ends_with(path)) {
+                        bindings_.push_back(Binding{slot, zone});
+                        found = true;
+                    }
+                }
+            }
+        }
+
+        if (!found)
+            std::cerr << "DspChain: no parameter matching " << path << std::endl;
+    }
+}
+
+void DspChain::setParameterTable(const ParameterTable* table) noexcept
+{
+    parameters_ = table;
+}
+
+void DspChain::prepare(int sampleRate)
+{
+    std::unique_ptr<DspArena> spare;
+    prepare(sampleRate, spare);
+}
+
+void DspChain::prepare(int sampleRate, std::unique_ptr<DspArena>& spare)
+{
+    destroyArenaStages();
+
+    std::size_t arenaBytes = 0;
+    for (const auto& stage : stages_) {
+        if (stage.measure)
+            arenaBytes += stage.measure(numChannels_ / stage.channelsPerInstance, sampleRate);
+    }
+
+    if (arenaBytes > 0 && !(arena_ && arena_->capacity() >= arenaBytes)) {
+        if (spare && spare->capacity() >= arenaBytes) {
+            arena_ = std::move(spare);
+            arena_->reset();
+        } else {
+            arena_ = std::make_unique<DspArena>(arenaBytes, arenaBytes >= HUGE_PAGE_ARENA_BYTES);
+            std::cout << "Effects arena: " << arena_->capacity() / 1024 << " KiB"
+                      << (arena_->usesHugePages() ? ", huge pages" : "")
+                      << (arena_->isLocked() ? ", locked" : ", not locked") << std::endl;
+        }
+    }
+
+    latencyFrames_ = 0.0;
+
+    for (auto& stage : stages_) {
+        if (stage.makePool) {
+            stage.pool = stage.makePool(*arena_, numChannels_ / stage.channelsPerInstance, sampleRate);
+            for (auto i{0u}; i < stage.pool->size(); ++i)
+                stage.instances.push_back(stage.pool->instance(i));
+        } else {
+            for (auto* instance : stage.instances)
+                instance->init(sampleRate);
+        }
+
+        for (auto* instance : stage.instances)
+            instance->instanceClear();
+        latencyFrames_ += getDspLatencyFrames(*stage.instances.front());
+    }
+
+    bindParameters();
+}
+
+std::unique_ptr<DspArena> DspChain::releaseArena()
+{
+    destroyArenaStages();
+    stages_.clear();
+    bindings_.clear();
+
+    if (arena_)
+        arena_->reset();
+    return std::move(arena_);
+}
+
+void DspChain::destroyArenaStages() noexcept
+{
+    for (auto& stage : stages_) {
+        if (stage.pool) {
+            stage.pool.reset();
+            stage.instances.clear();
+        }
+    }
+
+    if (arena_)
+        arena_->reset();
+}
+
+void DspChain::process(float *const *data, unsigned int nFrames) noexcept
+{
+    assert(nFrames <= maxFrames_);
+
+    if (stages_.empty()) return;
+
+    if (parameters_) {
+        for (const auto& binding : bindings_) {
+            if (const auto value = parameters_->get(binding.slot); !std::isnan(value))
+                *binding.zone = value;
+        }
+    }
+
+    // ping-pong between the caller buffers and scratch, Faust does not allow in place compute
+    float** src = dataPtrs_.data();
+    float** dst = scratchPtrs_.data();
+    std::copy_n(data, numChannels_, src);
+
+    const auto count = static_cast<int>(nFrames);
+    for (auto& stage : stages_) {
+        const auto cpi = stage.channelsPerInstance;
+        if (stage.pool) {
+            stage.pool->computeChannels(count, src, dst, cpi);
+        } else {
+            for (auto i{0u}; i < stage.instances.size(); ++i)
+                stage.instances[i]->compute(count, src + i * cpi, dst + i * cpi);
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != dataPtrs_.data()) {
+        for (auto c{0u}; c < numChannels_; ++c)
+            std::copy_n(src[c], nFrames, data[c]);
+    }
+}
+
+double DspChain::getLatencyFrames() const noexcept { return latencyFrames_; }
+unsigned int DspChain::getNumChannels() const noexcept { return numChannels_; }
+unsigned int DspChain::getMaxFrames() const noexcept { return maxFrames_; }
+bool DspChain::isEmpty() const noexcept { return stages_.empty(); }
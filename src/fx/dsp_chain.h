@@ -0,0 +1,129 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <faust/faustMinimalInlined.h>
+
+#include "dsp_arena.h"
+#include "dsp_pool.h"
+
+namespace fx {
+
+class ParameterTable;
+
+// Serial chain of Faust DSPs processing planar audio in place.
+// Stages either match the chain channel count or are mono, in which case the stage
+// is instantiated once per channel. Generated classes added with addStage<DSP>() become a
+// DspPool of their per channel instances, all pools live in one arena owned by the chain,
+// sized with DspArena::measure() once prepare() knows the sample rate. Other stages
+// (decorators like OversamplingDsp) are cloned on the heap.
+// Everything is allocated in addStage()/prepare(), process() does not allocate.
+class DspChain
+{
+public:
+    DspChain(unsigned int numChannels, unsigned int maxFrames);
+    ~DspChain();
+
+    DspChain(const DspChain&) = delete;
+    DspChain& operator=(const DspChain&) = delete;
+
+    // A generated Faust class, pooled in the chain arena by prepare()
+    template <typename DSP>
+    bool addStage();
+    bool addStage(std::unique_ptr<dsp> stage);
+
+    // Drives every control whose Faust path ends with path from a ParameterTable slot.
+    // Resolved by prepare(), once the arena stages exist.
+    void bindParameter(unsigned int slot, const std::string& path);
+    void setParameterTable(const ParameterTable* table) noexcept;
+
+    // Places the arena stages, then init(sampleRate) + instanceClear() on every stage.
+    // The arena comes from spare when that one is large enough. Not real-time safe.
+    void prepare(int sampleRate);
+    void prepare(int sampleRate, std::unique_ptr<DspArena>& spare);
+
+    // Destroys the stages and hands back the arena, reset, for the next chain to reuse.
+    // Not real-time safe.
+    std::unique_ptr<DspArena> releaseArena();
+
+    void process(float *const *data, unsigned int nFrames) noexcept;
+
+    // Sum of the stage latencies, valid after prepare()
+    double getLatencyFrames() const noexcept;
+
+    unsigned int getNumChannels() const noexcept;
+    unsigned int getMaxFrames() const noexcept;
+    bool isEmpty() const noexcept;
+
+private:
+    struct Stage
+    {
+        std::vector<dsp*> instances;
+        // heap stages own their instances, arena stages are destroyed in place by their pool
+        std::vector<std::unique_ptr<dsp>> owned;
+        std::unique_ptr<DspPoolBase> pool;
+        unsigned int channelsPerInstance{1};
+
+        // set for arena stages
+        std::size_t (*measure)(unsigned int numInstances, int sampleRate){nullptr};
+        std::unique_ptr<DspPoolBase> (*makePool)(DspArena& arena, unsigned int numInstances, int sampleRate){nullptr};
+    };
+
+    template <typename DSP>
+    static std::unique_ptr<DspPoolBase> makePool(DspArena& arena, unsigned int numInstances, int sampleRate);
+
+    bool checkChannels(int nIn, int nOut, Stage& stage) const;
+    void destroyArenaStages() noexcept;
+    void bindParameters();
+
+    // arena stages above this size go on huge pages where the system has them
+    static constexpr std::size_t HUGE_PAGE_ARENA_BYTES = 2 * 1024 * 1024;
+
+    unsigned int numChannels_;
+    unsigned int maxFrames_;
+    std::unique_ptr<DspArena> arena_;
+    std::vector<Stage> stages_;
+    double latencyFrames_{0.0};
+
+    struct Binding
+    {
+        unsigned int slot;
+        FAUSTFLOAT* zone;
+    };
+
+    const ParameterTable* parameters_{nullptr};
+    std::vector<std::pair<unsigned int, std::string>> requestedBindings_;
+    std::vector<Binding> bindings_;
+
+    std::vector<std::vector<float>> scratch_;
+    std::vector<float*> scratchPtrs_;
+    std::vector<float*> dataPtrs_;
+};
+
+template <typename DSP>
+bool DspChain::addStage()
+{
+    // only the channel counts are needed here, the instances come with prepare()
+    const auto probe = std::make_unique<DSP>();
+
+    Stage s;
+    if (!checkChannels(probe->getNumInputs(), probe->getNumOutputs(), s))
+        return false;
+
+    s.measure = &DspArena::measure<DSP>;
+    s.makePool = &makePool<DSP>;
+
+    stages_.push_back(std::move(s));
+    return true;
+}
+
+template <typename DSP>
+std::unique_ptr<DspPoolBase> DspChain::makePool(DspArena& arena, unsigned int numInstances, int sampleRate)
+{
+    return std::make_unique<DspPool<DSP>>(arena, numInstances, sampleRate);
+}
+
+} // namespace fx
@@ -0,0 +1,237 @@
+#include "dsp_chain_host.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using namespace fx;
+
+DspChainHost::DspChainHost()
+{
+    worker_ = std::thread([this] { workerLoop(); });
+}
+
+DspChainHost::~DspChainHost()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    cv_.notify_one();
+    worker_.join();
+
+    collectRetired();
+    delete pendingChain_.exchange(nullptr);
+    delete fading_;
+    delete current_;
+}
+
+void DspChainHost::prepare(unsigned int numChannels, unsigned int sampleRate, unsigned int maxFrames)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        numChannels_ = numChannels;
+        sampleRate_ = sampleRate;
+        maxFrames_ = maxFrames;
+        ++generation_;
+        rebuildRequested_ = static_cast<bool>(builder_);
+        requestedCrossfade_ = 0;
+    }
+
+    // the stream is not running, so the audio side can be reset directly
+    delete pendingChain_.exchange(nullptr);
+    delete fading_;
+    delete current_;
+    fading_ = nullptr;
+    current_ = nullptr;
+    latencyFrames_.store(0, std::memory_order_relaxed);
+    fadeActive_ = false;
+    fadeLength_ = 0;
+    fadePosition_ = 0;
+
+    fadeBuffers_.resize(numChannels);
+    fadePtrs_.resize(numChannels);
+    for (auto c{0u}; c < numChannels; ++c) {
+        fadeBuffers_[c].assign(maxFrames, 0.0f);
+        fadePtrs_[c] = fadeBuffers_[c].data();
+    }
+
+    cv_.notify_one();
+}
+
+void DspChainHost::rebuild(Builder builder, unsigned int crossfadeFrames)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        builder_ = std::move(builder);
+        requestedCrossfade_ = crossfadeFrames;
+        rebuildRequested_ = true;
+    }
+    cv_.notify_one();
+}
+
+void DspChainHost::setParameterTable(const ParameterTable* table)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    parameters_ = table;
+}
+
+void DspChainHost::workerLoop()
+{
+    using namespace std::chrono_literals;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!quit_) {
+        // wake up periodically to destroy chains retired by the audio thread
+        cv_.wait_for(lock, 50ms, [this] { return quit_ || rebuildRequested_; });
+        collectRetired();
+
+        if (swapDeferred_.exchange(false, std::memory_order_relaxed))
+            std::cerr << "Effects chain swap delayed, retired chains were not collected in time" << std::endl;
+
+        if (quit_ || !rebuildRequested_ || numChannels_ == 0) continue;
+
+        rebuildRequested_ = false;
+        const auto builder = builder_;
+        const auto numChannels = numChannels_;
+        const auto sampleRate = sampleRate_;
+        const auto maxFrames = maxFrames_;
+        const auto crossfade = requestedCrossfade_;
+        const auto generation = generation_;
+        const auto* parameters = parameters_;
+
+        lock.unlock();
+
+        auto chain = std::make_unique<DspChain>(numChannels, maxFrames);
+        chain->setParameterTable(parameters);
+        if (builder)
+            builder(*chain);
+        chain->prepare(static_cast<int>(sampleRate), spareArena_);
+
+        lock.lock();
+
+        // the stream format changed while building, a new rebuild is already requested
+        if (generation != generation_) continue;
+
+        pendingCrossfade_.store(std::min(crossfade, maxFrames), std::memory_order_relaxed);
+        // a chain the audio thread never picked up can be dropped right here
+        delete pendingChain_.exchange(chain.release(), std::memory_order_acq_rel);
+    }
+}
+
+bool DspChainHost::canRetire(unsigned int count) const noexcept
+{
+    // the producer's view of the size only overestimates it, the worker only takes chains out
+    return retired_.approxSize() + count <= retired_.capacity();
+}
+
+void DspChainHost::retire(DspChain* chain) noexcept
+{
+    if (!chain) return;
+
+    // callers checked canRetire() for it
+    [[maybe_unused]] const bool pushed = retired_.tryPush(chain);
+}
+
+void DspChainHost::collectRetired()
+{
+    DspChain* chain = nullptr;
+    while (retired_.tryPop(chain))
+        recycle(chain);
+}
+
+void DspChainHost::recycle(DspChain* chain)
+{
+    auto arena = chain->releaseArena();
+    delete chain;
+
+    // keep the largest one, a rebuild of the same effects then fits without new pages
+    if (arena && (!spareArena_ || arena->capacity() > spareArena_->capacity()))
+        spareArena_ = std::move(arena);
+}
+
+void DspChainHost::swapPending() noexcept
+{
+    if (!pendingChain_.load(std::memory_order_relaxed)) return;
+
+    // retires up to two chains, without room for them the swap waits for the worker
+    if (!canRetire(2)) {
+        swapDeferred_.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    auto* next = pendingChain_.exchange(nullptr, std::memory_order_acq_rel);
+    if (!next) return;
+
+    const auto crossfade = pendingCrossfade_.load(std::memory_order_relaxed);
+
+    // a swap during a running crossfade cuts the older fade short
+    retire(fading_);
+    fading_ = nullptr;
+
+    // without a current chain the fade starts from the dry signal
+    if (crossfade > 0) {
+        fading_ = current_;
+        fadeActive_ = true;
+        fadeLength_ = crossfade;
+        fadePosition_ = 0;
+    } else {
+        retire(current_);
+        fadeActive_ = false;
+    }
+
+    current_ = next;
+    latencyFrames_.store(static_cast<unsigned int>(std::lround(current_->getLatencyFrames())), std::memory_order_relaxed);
+}
+
+unsigned int DspChainHost::getLatencyFrames() const noexcept
+{
+    return latencyFrames_.load(std::memory_order_relaxed);
+}
+
+void DspChainHost::process(float *const *data, unsigned int nFrames) noexcept
+{
+    if (!fadeActive_ && fading_ && canRetire(1)) {
+        retire(fading_);
+        fading_ = nullptr;
+    }
+
+    swapPending();
+
+    if (!fadeActive_) {
+        if (current_)
+            current_->process(data, nFrames);
+        return;
+    }
+
+    const auto nChannels = static_cast<unsigned int>(fadePtrs_.size());
+
+    for (auto c{0u}; c < nChannels; ++c)
+        std::copy_n(data[c], nFrames, fadePtrs_[c]);
+
+    if (fading_)
+        fading_->process(fadePtrs_.data(), nFrames);
+    current_->process(data, nFrames);
+
+    const auto step = 1.0f / static_cast<float>(fadeLength_);
+    const auto fadeFrames = std::min(nFrames, fadeLength_ - fadePosition_);
+
+    for (auto c{0u}; c < nChannels; ++c) {
+        auto gain = static_cast<float>(fadePosition_) * step;
+        for (auto i{0u}; i < fadeFrames; ++i) {
+            data[c][i] = fadePtrs_[c][i] + gain * (data[c][i] - fadePtrs_[c][i]);
+            gain += step;
+        }
+    }
+
+    fadePosition_ += fadeFrames;
+    if (fadePosition_ >= fadeLength_) {
+        fadeActive_ = false;
+        // otherwise it stays idle in fading_ until a later buffer or the next swap retires it
+        if (canRetire(1)) {
+            retire(fading_);
+            fading_ = nullptr;
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spsc_mailbox.h"
+#include "dsp_chain.h"
+#include "parameter_table.h"
+
+namespace fx {
+
+// Owns the DspChain used by the audio callback and replaces it without stopping the stream.
+// New chains are built and prepared on a worker thread, picked up by the audio thread at
+// the start of a buffer (optionally crossfading from the old chain) and the old chain is
+// handed back to the worker to be destroyed. Its arena is reset and kept for the next
+// build rather than freed. While the worker has not yet collected enough
+// retired chains to make room, a new chain waits and the old one keeps playing.
+class DspChainHost
+{
+public:
+    using Builder = std::function<void(DspChain& chain)>;
+
+    DspChainHost();
+    ~DspChainHost();
+
+    DspChainHost(const DspChainHost&) = delete;
+    DspChainHost& operator=(const DspChainHost&) = delete;
+
+    // Not real-time safe. Called when the stream (re)starts, rebuilds the current chain
+    // for the new format.
+    void prepare(unsigned int numChannels, unsigned int sampleRate, unsigned int maxFrames);
+
+    // Schedules a rebuild on the worker thread, a nullptr builder removes all effects
+    void rebuild(Builder builder, unsigned int crossfadeFrames = 0);
+
+    // Chains built after this call read their bound parameters from table
+    void setParameterTable(const ParameterTable* table);
+
+    // Latency of the chain currently used by the audio thread, safe to call from any thread
+    unsigned int getLatencyFrames() const noexcept;
+
+    // -- Audio thread --
+    void process(float *const *data, unsigned int nFrames) noexcept;
+
+private:
+    void workerLoop();
+    // room in retired_ for count more chains, never more than there is
+    bool canRetire(unsigned int count) const noexcept;
+    void retire(DspChain* chain) noexcept;
+    void collectRetired();
+    void recycle(DspChain* chain);
+    void swapPending() noexcept;
+
+    // worker state
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool quit_{false};
+    bool rebuildRequested_{false};
+    Builder builder_;
+    unsigned int requestedCrossfade_{0};
+    unsigned int numChannels_{0};
+    unsigned int sampleRate_{0};
+    unsigned int maxFrames_{0};
+    unsigned int generation_{0};
+    const ParameterTable* parameters_{nullptr};
+    // arena of a retired chain, reused by the next build
+    std::unique_ptr<DspArena> spareArena_;
+
+    // hand over between worker and audio thread
+    std::atomic<DspChain*> pendingChain_{nullptr};
+    std::atomic<unsigned int> pendingCrossfade_{0};
+    SpscMailbox<DspChain*> retired_{16};
+    // set by the audio thread when a swap had to wait for room in retired_, printed by the worker
+    std::atomic<bool> swapDeferred_{false};
+    std::atomic<unsigned int> latencyFrames_{0};
+
+    // audio thread state
+    DspChain* current_{nullptr};
+    DspChain* fading_{nullptr};
+    bool fadeActive_{false};
+    unsigned int fadeLength_{0};
+    unsigned int fadePosition_{0};
+    std::vector<std::vector<float>> fadeBuffers_;
+    std::vector<float*> fadePtrs_;
+};
+
+} // namespace fx
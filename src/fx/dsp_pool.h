@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cassert>
+#include <new>
+#include <vector>
+
+#include <faust/faustMinimalInlined.h>
+
+#include "dsp_arena.h"
+
+namespace fx {
+
+// Type erased DspPool, lets DspChain hold pools of any class and pay one virtual call
+// per pool and buffer instead of one per instance.
+class DspPoolBase
+{
+public:
+    virtual ~DspPoolBase() = default;
+
+    virtual unsigned int size() const noexcept = 0;
+    virtual dsp* instance(unsigned int index) noexcept = 0;
+    virtual void instanceClear() noexcept = 0;
+
+    // Instance i processes channels [i * channelsPerInstance, (i + 1) * channelsPerInstance)
+    virtual void computeChannels(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs,
+                                 unsigned int channelsPerInstance) noexcept = 0;
+};
+
+// Many instances of the same generated Faust class, e.g. one effect per channel or track.
+// The static class tables are initialized once, all instances live back to back in an
+// arena sized for them with DspArena::measure<DSP>() and are always processed in that
+// (address) order. Several pools can share one arena.
+// Classes generated with -mem keep their static tables in the arena of the pool created
+// last, so that arena has to outlive the pools of the same class created before it.
+template <typename DSP>
+class DspPool final : public DspPoolBase
+{
+public:
+    DspPool(DspArena& arena, unsigned int numInstances, int sampleRate)
+        : arena_(arena)
+    {
+        static_assert(alignof(DSP) <= DspArena::ALIGNMENT);
+
+        // classes generated with -mem take their tables from the manager
+        if constexpr (requires { DSP::fManager; })
+            DSP::fManager = &arena_;
+
+        DSP::classInit(sampleRate);
+
+        instances_.reserve(numInstances);
+        for (auto i{0u}; i < numInstances; ++i) {
+            auto* instance = new (arena_.allocate(sizeof(DSP))) DSP();
+            if constexpr (requires { instance->memoryCreate(); })
+                instance->memoryCreate();
+            instance->DSP::instanceInit(sampleRate);
+            instances_.push_back(instance);
+        }
+    }
+
+    ~DspPool() override
+    {
+        // the arena memory itself is only recycled with DspArena::reset()
+        for (auto* instance : instances_) {
+            if constexpr (requires { instance->memoryDestroy(); })
+                instance->memoryDestroy();
+            instance->~DSP();
+        }
+
+        if constexpr (requires { DSP::classDestroy(); })
+            DSP::classDestroy();
+    }
+
+    DspPool(const DspPool&) = delete;
+    DspPool& operator=(const DspPool&) = delete;
+
+    unsigned int size() const noexcept override { return static_cast<unsigned int>(instances_.size()); }
+
+    dsp* instance(unsigned int index) noexcept override
+    {
+        assert(index < instances_.size());
+        return instances_[index];
+    }
+
+    DSP& operator[](unsigned int index) noexcept
+    {
+        assert(index < instances_.size());
+        return *instances_[index];
+    }
+
+    int getNumInputs() const noexcept { return instances_.empty() ? 0 : instances_.front()->DSP::getNumInputs(); }
+    int getNumOutputs() const noexcept { return instances_.empty() ? 0 : instances_.front()->DSP::getNumOutputs(); }
+
+    void instanceClear() noexcept override
+    {
+        for (auto* instance : instances_)
+            instance->DSP::instanceClear();
+    }
+
+    void compute(unsigned int index, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) noexcept
+    {
+        assert(index < instances_.size());
+        instances_[index]->DSP::compute(count, inputs, outputs);
+    }
+
+    // inputs[i] / outputs[i] are the channel lists of instance i
+    void computeAll(int count, FAUSTFLOAT** const* inputs, FAUSTFLOAT** const* outputs) noexcept
+    {
+        const auto n = instances_.size();
+        for (auto i{0u}; i < n; ++i)
+            instances_[i]->DSP::compute(count, inputs[i], outputs[i]);
+    }
+
+    void computeChannels(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs,
+                         unsigned int channelsPerInstance) noexcept override
+    {
+        const auto n = instances_.size();
+        for (auto i{0u}; i < n; ++i)
+            instances_[i]->DSP::compute(count, inputs + i * channelsPerInstance, outputs + i * channelsPerInstance);
+    }
+
+    const DspArena& getArena() const noexcept { return arena_; }
+
+    static constexpr std::size_t instanceStride() noexcept { return DspArena::alignUp(sizeof(DSP)); }
+
+private:
+    DspArena& arena_;
+    std::vector<DSP*> instances_;
+};
+
+} // namespace fx
@@ -0,0 +1,164 @@
+#include "halfband.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numbers>
+
+#if defined(__SSE__) || defined(_M_X64)
+    #include <xmmintrin.h>
+    #define HALFBAND_SSE
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define HALFBAND_NEON
+#endif
+
+namespace fx {
+
+static constexpr double KAISER_BETA = 8.0;
+
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (auto k{1}; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+float dotProduct(const float *a, const float *b, unsigned int n) noexcept
+{
+    unsigned int i = 0;
+    float result = 0.0f;
+
+#if defined(HALFBAND_SSE)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    for (; i + 4 <= n; i += 4)
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, _mm_add_ps(acc0, acc1));
+    result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(HALFBAND_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4)
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+    result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+    for (; i < n; ++i)
+        result += a[i] * b[i];
+
+    return result;
+}
+
+HalfbandFilter::HalfbandFilter(unsigned int order)
+    : order_(order | 1u), numTaps_(order_ + 1)
+{
+    // Kaiser windowed sinc with its cutoff at a quarter of the higher sample rate.
+    // Only the odd offsets from the centre are stored, they form the FIR branch.
+    branch_.resize(numTaps_);
+
+    const auto m = static_cast<double>(order_);
+    const auto i0Beta = besselI0(KAISER_BETA);
+
+    for (auto j{0u}; j < numTaps_; ++j) {
+        const auto d = 2.0 * j - m;
+        const auto x = std::numbers::pi * d / 2.0;
+        const auto sinc = std::sin(x) / x;
+        const auto r = d / (m + 1.0);
+        const auto window = besselI0(KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - r * r))) / i0Beta;
+        branch_[j] = static_cast<float>(0.5 * sinc * window);
+    }
+
+    // normalize so the branch sums to 0.5, giving unity DC gain together with the centre tap
+    double sum = 0.0;
+    for (const auto c : branch_) sum += c;
+    for (auto& c : branch_) c = static_cast<float>(c * 0.5 / sum);
+}
+
+unsigned int HalfbandFilter::getOrder() const noexcept { return order_; }
+unsigned int HalfbandFilter::getNumTaps() const noexcept { return numTaps_; }
+
+void HalfbandFilter::History::resize(unsigned int newSize)
+{
+    size = newSize;
+    data.assign(2 * size, 0.0f);
+    pos = 0;
+}
+
+void HalfbandFilter::History::clear() noexcept
+{
+    std::fill(data.begin(), data.end(), 0.0f);
+    pos = 0;
+}
+
+void HalfbandFilter::History::push(float sample) noexcept
+{
+    pos = (pos + 1 == size) ? 0 : pos + 1;
+    data[pos] = sample;
+    data[pos + size] = sample;
+}
+
+HalfbandUpsampler::HalfbandUpsampler(unsigned int order)
+    : HalfbandFilter(order)
+{
+    history_.resize(numTaps_);
+}
+
+void HalfbandUpsampler::reset() noexcept
+{
+    history_.clear();
+}
+
+void HalfbandUpsampler::process(const float *in, float *out, unsigned int nFrames) noexcept
+{
+    // y[2m]     = 2 * sum_j branch[j] * x[m - j]
+    // y[2m + 1] = x[m - (order - 1) / 2]
+    const auto delayIndex = numTaps_ - 1 - (order_ - 1) / 2;
+
+    for (auto i{0u}; i < nFrames; ++i) {
+        history_.push(in[i]);
+        const float* window = history_.window();
+        out[2 * i] = 2.0f * dotProduct(window, branch_.data(), numTaps_);
+        out[2 * i + 1] = window[delayIndex];
+    }
+}
+
+HalfbandDownsampler::HalfbandDownsampler(unsigned int order)
+    : HalfbandFilter(order)
+{
+    even_.resize(numTaps_);
+    odd_.resize(numTaps_);
+}
+
+void HalfbandDownsampler::reset() noexcept
+{
+    even_.clear();
+    odd_.clear();
+}
+
+void HalfbandDownsampler::process(const float *in, float *out, unsigned int nFrames) noexcept
+{
+    // z[m] = sum_j branch[j] * v[2m - 2j] + 0.5 * v[2m - order]
+    const auto delayIndex = numTaps_ - (order_ + 1) / 2;
+
+    for (auto i{0u}; i < nFrames; ++i) {
+        even_.push(in[2 * i]);
+        const float delayed = odd_.window()[delayIndex];
+        out[i] = dotProduct(even_.window(), branch_.data(), numTaps_) + 0.5f * delayed;
+        odd_.push(in[2 * i + 1]);
+    }
+}
+
+} // namespace fx
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+namespace fx {
+
+// Polyphase half-band FIR stages for 2x resampling.
+// The prototype filter has 2 * order + 1 taps (order odd), every second tap apart from the
+// centre is zero, so one polyphase branch is a pure delay and the other is an
+// (order + 1) tap FIR. Both directions delay the signal by order / 2 samples at the
+// lower rate.
+class HalfbandFilter
+{
+public:
+    explicit HalfbandFilter(unsigned int order);
+
+    unsigned int getOrder() const noexcept;
+    unsigned int getNumTaps() const noexcept;
+
+protected:
+    // contiguous view of the last numTaps_ samples, oldest first
+    struct History
+    {
+        void resize(unsigned int newSize);
+        void clear() noexcept;
+        void push(float sample) noexcept;
+        const float* window() const noexcept { return data.data() + pos + 1; }
+
+        std::vector<float> data;
+        unsigned int size{0};
+        unsigned int pos{0};
+    };
+
+    unsigned int order_;
+    unsigned int numTaps_;
+    std::vector<float> branch_;
+};
+
+class HalfbandUpsampler : public HalfbandFilter
+{
+public:
+    explicit HalfbandUpsampler(unsigned int order);
+
+    void reset() noexcept;
+
+    // writes 2 * nFrames samples to out
+    void process(const float *in, float *out, unsigned int nFrames) noexcept;
+
+private:
+    History history_;
+};
+
+class HalfbandDownsampler : public HalfbandFilter
+{
+public:
+    explicit HalfbandDownsampler(unsigned int order);
+
+    void reset() noexcept;
+
+    // reads 2 * nFrames samples from in
+    void process(const float *in, float *out, unsigned int nFrames) noexcept;
+
+private:
+    History even_;
+    History odd_;
+};
+
+// SIMD dot product used by the FIR branches
+float dotProduct(const float *a, const float *b, unsigned int n) noexcept;
+
+// Zeroth order modified Bessel function of the first kind, for Kaiser windows
+double besselI0(double x);
+
+} // namespace fx
@@ -0,0 +1,33 @@
+#include "latency.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace fx {
+
+namespace {
+
+struct LatencyMeta final : Meta
+{
+    void declare(const char* key, const char* value) override
+    {
+        if (std::strcmp(key, "latency_frames") == 0)
+            latency = std::strtod(value, nullptr);
+    }
+
+    double latency{0.0};
+};
+
+} // namespace
+
+double getDspLatencyFrames(dsp& d)
+{
+    if (const auto* reporter = dynamic_cast<const LatencyReporter*>(&d))
+        return reporter->getLatencyFrames();
+
+    LatencyMeta meta;
+    d.metadata(&meta);
+    return meta.latency;
+}
+
+} // namespace fx
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <faust/faustMinimalInlined.h>
+
+namespace fx {
+
+// Implemented by stages that delay their signal, e.g. OversamplingDsp
+class LatencyReporter
+{
+public:
+    virtual ~LatencyReporter() = default;
+
+    // Delay in frames at the stream sample rate
+    virtual double getLatencyFrames() const noexcept = 0;
+};
+
+// Latency of any Faust DSP: LatencyReporter stages report it directly, generated DSPs
+// can declare it in their source with  declare latency_frames "N";
+double getDspLatencyFrames(dsp& d);
+
+} // namespace fx
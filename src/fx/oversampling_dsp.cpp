@@ -0,0 +1,159 @@
+#include "oversampling_dsp.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace fx;
+
+// Half-band orders per stage, the first stage (next to the stream rate) needs the
+// steepest transition, later stages only have to reject images far above the audio band.
+static constexpr unsigned int STAGE_ORDERS[] = {31, 15, 7};
+
+static unsigned int stagesForFactor(unsigned int factor)
+{
+    switch (factor) {
+        case 2: return 1;
+        case 4: return 2;
+        case 8: return 3;
+        default: throw std::invalid_argument("OversamplingDsp: factor must be 2, 4 or 8");
+    }
+}
+
+OversamplingDsp::OversamplingDsp(dsp* inner, unsigned int factor, unsigned int maxFrames)
+    : decorator_dsp(inner), factor_(factor), numStages_(stagesForFactor(factor)), maxFrames_(maxFrames)
+{
+    const auto makeChannels = [this](std::vector<Channel>& channels, int count) {
+        channels.resize(static_cast<std::size_t>(count));
+        for (auto& channel : channels) {
+            for (auto s{0u}; s < numStages_; ++s) {
+                channel.up.emplace_back(std::make_unique<HalfbandUpsampler>(STAGE_ORDERS[s]));
+                channel.down.emplace_back(std::make_unique<HalfbandDownsampler>(STAGE_ORDERS[s]));
+            }
+        }
+    };
+
+    const auto nIn = fDSP->getNumInputs();
+    const auto nOut = fDSP->getNumOutputs();
+    makeChannels(inputChannels_, nIn);
+    makeChannels(outputChannels_, nOut);
+
+    const auto oversampledFrames = static_cast<std::size_t>(maxFrames_) * factor_;
+    inputBuffers_.assign(static_cast<std::size_t>(nIn), std::vector<float>(oversampledFrames));
+    outputBuffers_.assign(static_cast<std::size_t>(nOut), std::vector<float>(oversampledFrames));
+    stageBuffers_.assign(2, std::vector<float>(oversampledFrames));
+
+    for (auto& b : inputBuffers_) innerInputs_.push_back(b.data());
+    for (auto& b : outputBuffers_) innerOutputs_.push_back(b.data());
+
+    blockInputs_.resize(static_cast<std::size_t>(nIn));
+    blockOutputs_.resize(static_cast<std::size_t>(nOut));
+}
+
+OversamplingDsp::~OversamplingDsp() = default;
+
+int OversamplingDsp::getSampleRate() { return sampleRate_; }
+
+void OversamplingDsp::init(int sample_rate)
+{
+    sampleRate_ = sample_rate;
+    fDSP->init(sample_rate * static_cast<int>(factor_));
+    innerLatencyFrames_ = getDspLatencyFrames(*fDSP) / factor_;
+    instanceClear();
+}
+
+void OversamplingDsp::instanceInit(int sample_rate)
+{
+    sampleRate_ = sample_rate;
+    fDSP->instanceInit(sample_rate * static_cast<int>(factor_));
+    instanceClear();
+}
+
+void OversamplingDsp::instanceConstants(int sample_rate)
+{
+    sampleRate_ = sample_rate;
+    fDSP->instanceConstants(sample_rate * static_cast<int>(factor_));
+}
+
+void OversamplingDsp::instanceClear()
+{
+    fDSP->instanceClear();
+
+    for (auto* channels : {&inputChannels_, &outputChannels_}) {
+        for (auto& channel : *channels) {
+            for (auto& up : channel.up) up->reset();
+            for (auto& down : channel.down) down->reset();
+        }
+    }
+}
+
+OversamplingDsp* OversamplingDsp::clone()
+{
+    return new OversamplingDsp(fDSP->clone(), factor_, maxFrames_);
+}
+
+void OversamplingDsp::compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+{
+    if (count <= static_cast<int>(maxFrames_)) {
+        computeBlock(count, inputs, outputs);
+        return;
+    }
+
+    for (int offset = 0; offset < count; offset += static_cast<int>(maxFrames_)) {
+        const auto block = std::min(count - offset, static_cast<int>(maxFrames_));
+        for (auto c{0u}; c < blockInputs_.size(); ++c) blockInputs_[c] = inputs[c] + offset;
+        for (auto c{0u}; c < blockOutputs_.size(); ++c) blockOutputs_[c] = outputs[c] + offset;
+        computeBlock(block, blockInputs_.data(), blockOutputs_.data());
+    }
+}
+
+void OversamplingDsp::compute(double /*date_usec*/, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+{
+    compute(count, inputs, outputs);
+}
+
+void OversamplingDsp::computeBlock(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) noexcept
+{
+    const auto frames = static_cast<unsigned int>(count);
+
+    // stream rate -> oversampled rate, ping-ponging through the stage buffers
+    for (auto c{0u}; c < inputChannels_.size(); ++c) {
+        auto& channel = inputChannels_[c];
+        const float* src = inputs[c];
+        auto n = frames;
+        for (auto s{0u}; s < numStages_; ++s) {
+            float* dst = (s + 1 == numStages_) ? innerInputs_[c] : stageBuffers_[s % 2].data();
+            channel.up[s]->process(src, dst, n);
+            src = dst;
+            n *= 2;
+        }
+    }
+
+    fDSP->compute(count * static_cast<int>(factor_), innerInputs_.data(), innerOutputs_.data());
+
+    // oversampled rate -> stream rate, the last upsampling stage is undone first
+    for (auto c{0u}; c < outputChannels_.size(); ++c) {
+        auto& channel = outputChannels_[c];
+        const float* src = innerOutputs_[c];
+        auto n = frames * factor_;
+        for (auto s = numStages_; s-- > 0;) {
+            n /= 2;
+            float* dst = (s == 0) ? outputs[c] : stageBuffers_[s % 2].data();
+            channel.down[s]->process(src, dst, n);
+            src = dst;
+        }
+    }
+}
+
+unsigned int OversamplingDsp::getFactor() const noexcept { return factor_; }
+
+double OversamplingDsp::getLatencyFrames() const noexcept
+{
+    // each stage delays by order / 2 samples at its lower rate, once up and once down
+    double latency = innerLatencyFrames_;
+    double rate = 1.0;
+    for (auto s{0u}; s < numStages_; ++s) {
+        latency += static_cast<double>(STAGE_ORDERS[s]) / rate;
+        rate *= 2.0;
+    }
+    return latency;
+}
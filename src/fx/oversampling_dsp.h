@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <faust/faustMinimalInlined.h>
+
+#include "halfband.h"
+#include "latency.h"
+
+namespace fx {
+
+// Runs the wrapped DSP at 2x, 4x or 8x the stream rate through cascaded half-band
+// up/down-samplers. Buffers are sized for maxFrames at construction, compute() never
+// allocates and splits larger blocks.
+class OversamplingDsp final : public decorator_dsp, public LatencyReporter
+{
+public:
+    static constexpr unsigned int MAX_FACTOR = 8;
+
+    OversamplingDsp(dsp* inner, unsigned int factor, unsigned int maxFrames);
+    ~OversamplingDsp() override;
+
+    int getSampleRate() override;
+    void init(int sample_rate) override;
+    void instanceInit(int sample_rate) override;
+    void instanceConstants(int sample_rate) override;
+    void instanceClear() override;
+    OversamplingDsp* clone() override;
+
+    void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) override;
+    void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) override;
+
+    unsigned int getFactor() const noexcept;
+
+    // Round trip delay of the resampling filters plus the wrapped DSP, in frames at the stream rate
+    double getLatencyFrames() const noexcept override;
+
+private:
+    struct Channel
+    {
+        std::vector<std::unique_ptr<HalfbandUpsampler>> up;
+        std::vector<std::unique_ptr<HalfbandDownsampler>> down;
+    };
+
+    void computeBlock(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) noexcept;
+
+    unsigned int factor_;
+    unsigned int numStages_;
+    unsigned int maxFrames_;
+    int sampleRate_{0};
+    double innerLatencyFrames_{0.0};
+
+    std::vector<Channel> inputChannels_;
+    std::vector<Channel> outputChannels_;
+
+    // per channel buffers at the oversampled rate, two per channel to ping-pong between stages
+    std::vector<std::vector<float>> inputBuffers_;
+    std::vector<std::vector<float>> outputBuffers_;
+    std::vector<std::vector<float>> stageBuffers_;
+    std::vector<float*> innerInputs_;
+    std::vector<float*> innerOutputs_;
+    std::vector<float*> blockInputs_;
+    std::vector<float*> blockOutputs_;
+};
+
+} // namespace fx
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace fx {
+
+// Fixed set of parameter slots written by control sources (MIDI, UI) from any thread and
+// read by the DSP chain once per buffer. Slots that were never written hold NaN and leave
+// the Faust default untouched.
+class ParameterTable
+{
+public:
+    static constexpr unsigned int MAX_PARAMETERS = 64;
+
+    ParameterTable() noexcept
+    {
+        for (auto& v : values_)
+            v.store(std::numeric_limits<float>::quiet_NaN(), std::memory_order_relaxed);
+    }
+
+    void set(unsigned int slot, float value) noexcept
+    {
+        if (slot < MAX_PARAMETERS)
+            values_[slot].store(value, std::memory_order_relaxed);
+    }
+
+    float get(unsigned int slot) const noexcept
+    {
+        return slot < MAX_PARAMETERS ? values_[slot].load(std::memory_order_relaxed)
+                                     : std::numeric_limits<float>::quiet_NaN();
+    }
+
+private:
+    std::array<std::atomic<float>, MAX_PARAMETERS> values_;
+};
+
+} // namespace fx
@@ -0,0 +1,212 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+#include "halfband.h"
+
+namespace fx {
+
+struct QualitySettings
+{
+    unsigned int zeroCrossings;
+    unsigned int numPhases;
+    double kaiserBeta;
+    // -6 dB point relative to the lower Nyquist frequency
+    double cutoff;
+};
+
+// More zero crossings narrow the transition band, more phases lower the error of the phase
+// interpolation, beta trades stopband attenuation for transition width
+static QualitySettings getSettings(Resampler::Quality quality)
+{
+    switch (quality) {
+        case Resampler::Quality::DRAFT: return {8, 32, 6.0, 0.85};
+        case Resampler::Quality::NORMAL: return {16, 128, 8.0, 0.90};
+        case Resampler::Quality::HIGH: return {32, 256, 10.0, 0.94};
+        case Resampler::Quality::BEST: return {64, 1024, 12.0, 0.96};
+    }
+    return {16, 128, 8.0, 0.90};
+}
+
+void Resampler::prepare(unsigned int numChannels, double ratio, Quality quality)
+{
+    const auto settings = getSettings(quality);
+
+    // going down, the kernel widens to cut off below the new Nyquist frequency
+    const auto cutoff = settings.cutoff * std::min(1.0, ratio);
+
+    // multiple of 8 taps, so the dot products never fall back to their scalar tail
+    auto halfTaps = static_cast<unsigned int>(std::ceil(settings.zeroCrossings / cutoff));
+    halfTaps = (halfTaps + 3) & ~3u;
+
+    numChannels_ = numChannels;
+    numTaps_ = 2 * halfTaps;
+    numPhases_ = settings.numPhases;
+    kernel_.assign(static_cast<std::size_t>(numPhases_ + 1) * numTaps_, 0.0f);
+
+    // row p holds the taps for an output frac = p / numPhases after the window centre,
+    // window order (oldest input first). Row numPhases is row 0 one input later, it is only
+    // there so interpolation never needs a special case.
+    const auto i0Beta = besselI0(settings.kaiserBeta);
+    for (auto p{0u}; p <= numPhases_; ++p) {
+        const auto frac = static_cast<double>(p) / numPhases_;
+        auto* row = kernel_.data() + static_cast<std::size_t>(p) * numTaps_;
+
+        double sum = 0.0;
+        for (auto i{0u}; i < numTaps_; ++i) {
+            const auto t = frac + halfTaps - 1.0 - i;
+            const auto x = std::numbers::pi * cutoff * t;
+            const auto sinc = x == 0.0 ? 1.0 : std::sin(x) / x;
+            const auto r = t / halfTaps;
+            const auto window = besselI0(settings.kaiserBeta * std::sqrt(std::max(0.0, 1.0 - r * r))) / i0Beta;
+            row[i] = static_cast<float>(sinc * window);
+            sum += row[i];
+        }
+
+        // unity DC gain for every phase
+        for (auto i{0u}; i < numTaps_; ++i)
+            row[i] = static_cast<float>(row[i] / sum);
+    }
+
+    history_.assign(numChannels_, std::vector<float>(2 * numTaps_, 0.0f));
+    setRatio(ratio);
+    reset();
+}
+
+void Resampler::reset() noexcept
+{
+    for (auto& h : history_)
+        std::fill(h.begin(), h.end(), 0.0f);
+    historyPos_ = 0;
+    frac_ = 1.0;
+}
+
+void Resampler::setRatio(double ratio) noexcept
+{
+    step_ = 1.0 / ratio;
+}
+
+double Resampler::getRatio() const noexcept
+{
+    return 1.0 / step_;
+}
+
+float Resampler::interpolate(const float *window, double frac) const noexcept
+{
+    const auto phase = frac * numPhases_;
+    const auto p = std::min(static_cast<unsigned int>(phase), numPhases_ - 1);
+    const auto a = static_cast<float>(phase - p);
+
+    const auto* row = kernel_.data() + static_cast<std::size_t>(p) * numTaps_;
+    const auto y0 = dotProduct(window, row, numTaps_);
+    const auto y1 = dotProduct(window, row + numTaps_, numTaps_);
+    return y0 + a * (y1 - y0);
+}
+
+unsigned int Resampler::process(const float *const *in, unsigned int nIn, float *const *out, unsigned int maxOut,
+                                unsigned int& consumed) noexcept
+{
+    unsigned int produced = 0;
+    consumed = 0;
+
+    while (true) {
+        // every output between this input frame and the next
+        while (frac_ < 1.0) {
+            if (produced == maxOut) return produced;
+
+            for (auto ch{0u}; ch < numChannels_; ++ch)
+                out[ch][produced] = interpolate(history_[ch].data() + historyPos_ + 1, frac_);
+            ++produced;
+            frac_ += step_;
+        }
+
+        if (consumed == nIn) return produced;
+
+        historyPos_ = historyPos_ + 1 == numTaps_ ? 0 : historyPos_ + 1;
+        for (auto ch{0u}; ch < numChannels_; ++ch) {
+            history_[ch][historyPos_] = in[ch][consumed];
+            history_[ch][historyPos_ + numTaps_] = in[ch][consumed];
+        }
+        ++consumed;
+        frac_ -= 1.0;
+    }
+}
+
+unsigned int Resampler::getInputFramesNeeded(unsigned int numOut) const noexcept
+{
+    if (numOut == 0) return 0;
+    const auto last = frac_ + (numOut - 1) * step_;
+    return last < 1.0 ? 0u : static_cast<unsigned int>(last);
+}
+
+unsigned int Resampler::getLatency() const noexcept
+{
+    return numTaps_ / 2;
+}
+
+unsigned int Resampler::getNumTaps() const noexcept
+{
+    return numTaps_;
+}
+
+void Resampler::convert(const float *in, unsigned int inFrames, float *out, unsigned int firstOut, unsigned int numOut,
+                        bool circular) const
+{
+    if (inFrames == 0) {
+        std::fill_n(out, numOut, 0.0f);
+        return;
+    }
+
+    const auto halfTaps = static_cast<long long>(numTaps_ / 2);
+    const auto length = static_cast<long long>(inFrames);
+    std::vector<float> edge(numTaps_);
+
+    for (auto o{0u}; o < numOut; ++o) {
+        const auto t = (static_cast<double>(firstOut) + o) * step_;
+        const auto base = static_cast<long long>(t);
+        const auto start = base - halfTaps + 1;
+
+        // the ends are gathered into a scratch window, the rest is read in place. in + start is
+        // only formed once start is known to lie within in.
+        const float* window = edge.data();
+        if (start < 0 || start + numTaps_ > length) {
+            for (auto i{0u}; i < numTaps_; ++i) {
+                auto frame = start + i;
+                if (circular) {
+                    frame %= length;
+                    if (frame < 0) frame += length;
+                }
+                edge[i] = frame >= 0 && frame < length ? in[frame] : 0.0f;
+            }
+        } else {
+            window = in + start;
+        }
+
+        out[o] = interpolate(window, t - static_cast<double>(base));
+    }
+}
+
+std::vector<std::vector<float>> resample(const std::vector<std::vector<float>>& channels, unsigned int fromRate,
+                                         unsigned int toRate, Resampler::Quality quality)
+{
+    if (fromRate == toRate || fromRate == 0 || toRate == 0)
+        return channels;
+
+    Resampler resampler;
+    resampler.prepare(1, static_cast<double>(toRate) / fromRate, quality);
+
+    std::vector<std::vector<float>> result;
+    result.reserve(channels.size());
+    for (const auto& channel : channels) {
+        const auto inFrames = static_cast<std::uint64_t>(channel.size());
+        const auto outFrames = static_cast<unsigned int>((inFrames * toRate + fromRate - 1) / fromRate);
+        auto& out = result.emplace_back(outFrames);
+        resampler.convert(channel.data(), static_cast<unsigned int>(inFrames), out.data(), 0, outFrames, false);
+    }
+    return result;
+}
+
+} // namespace fx
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+namespace fx {
+
+// Arbitrary ratio sample-rate converter with a Kaiser windowed sinc kernel, stored as a bank
+// of polyphase rows and linearly interpolated between neighbouring phases. The inner loops
+// are the SIMD dot products of the half-band filters.
+//
+// Streaming: process() converts running audio, setRatio() may nudge the ratio (drift
+// compensation) without redesigning the filter.
+// Offline: convert() produces any range of a whole buffer, zero padded or circular (loops).
+class Resampler
+{
+public:
+    enum class Quality
+    {
+        DRAFT,
+        NORMAL,
+        HIGH,
+        BEST,
+    };
+
+    // Not real-time safe. ratio is output rate / input rate.
+    void prepare(unsigned int numChannels, double ratio, Quality quality);
+
+    // -- Streaming, audio thread --
+    void reset() noexcept;
+    void setRatio(double ratio) noexcept;
+    double getRatio() const noexcept;
+
+    // Reads up to nIn frames and writes up to maxOut frames, stops at whichever runs out first.
+    // Returns the number of frames written, consumed is the number of frames read.
+    unsigned int process(const float *const *in, unsigned int nIn, float *const *out, unsigned int maxOut,
+                         unsigned int& consumed) noexcept;
+
+    // Frames process() has to read before it can write numOut frames
+    unsigned int getInputFramesNeeded(unsigned int numOut) const noexcept;
+
+    // Delay of the streamed output, in input frames
+    unsigned int getLatency() const noexcept;
+
+    // -- Offline, leaves the streaming state alone --
+    // Writes output frames [firstOut, firstOut + numOut) of the inFrames long in, output frame 0
+    // lines up with input frame 0. circular wraps around the ends instead of padding with zeros.
+    void convert(const float *in, unsigned int inFrames, float *out, unsigned int firstOut, unsigned int numOut,
+                 bool circular) const;
+
+    unsigned int getNumTaps() const noexcept;
+
+private:
+    float interpolate(const float *window, double frac) const noexcept;
+
+    unsigned int numChannels_{0};
+    unsigned int numTaps_{0};
+    unsigned int numPhases_{0};
+    std::vector<float> kernel_;
+
+    double step_{1.0};
+    double frac_{1.0};
+
+    // per channel, last numTaps_ input frames mirrored so every window is contiguous
+    std::vector<std::vector<float>> history_;
+    unsigned int historyPos_{0};
+};
+
+// Offline conversion of whole channels from one sample rate to another
+std::vector<std::vector<float>> resample(const std::vector<std::vector<float>>& channels, unsigned int fromRate,
+                                         unsigned int toRate, Resampler::Quality quality = Resampler::Quality::HIGH);
+
+} // namespace fx
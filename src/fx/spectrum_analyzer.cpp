@@ -0,0 +1,155 @@
+#include "spectrum_analyzer.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+using namespace fx;
+
+// When the worker is this far behind it skips to the newest audio
+static constexpr unsigned int MAX_BACKLOG_FRAMES = 4 * SpectrumAnalyzer::HOP_FRAMES;
+
+SpectrumAnalyzer::SpectrumAnalyzer()
+{
+    // the plan and all buffers are sized once, only the capture ring depends on the format
+    plan_ = kiss_fftr_alloc(FFT_SIZE, 0, nullptr, nullptr);
+
+    window_.resize(FFT_SIZE);
+    auto windowSum = 0.0;
+    for (auto i{0u}; i < FFT_SIZE; ++i) {
+        window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * i / FFT_SIZE));
+        windowSum += window_[i];
+    }
+    // a full scale sine peaks at 0 dB
+    normalization_ = static_cast<float>(2.0 / windowSum);
+
+    frame_.resize(FFT_SIZE);
+    spectrum_.resize(NUM_BINS);
+    magnitudes_.forEach([](std::vector<float>& slot) { slot.assign(NUM_BINS, MIN_DB); });
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    stop();
+    kiss_fftr_free(plan_);
+}
+
+void SpectrumAnalyzer::prepare(unsigned int numChannels, unsigned int sampleRate, unsigned int maxFrames)
+{
+    stop();
+
+    // room for the analysis window plus a few callbacks, so the audio thread stays clear of
+    // the frames being read unless the worker stalls
+    const auto capacity = std::bit_ceil(static_cast<std::uint64_t>(4 * (FFT_SIZE + maxFrames)));
+    ring_.assign(numChannels, std::vector<float>(capacity, 0.0f));
+    ringMask_ = capacity - 1;
+    numChannels_ = numChannels;
+    maxFrames_ = maxFrames;
+    sampleRate_.store(sampleRate, std::memory_order_relaxed);
+    writeIndex_.store(0, std::memory_order_relaxed);
+
+    running_.store(true, std::memory_order_release);
+    worker_ = std::thread([this] { workerLoop(); });
+}
+
+void SpectrumAnalyzer::stop()
+{
+    running_.store(false, std::memory_order_release);
+    if (worker_.joinable())
+        worker_.join();
+}
+
+void SpectrumAnalyzer::push(const float *const *data, unsigned int nFrames) noexcept
+{
+    if (ring_.empty()) return;
+
+    const auto capacity = ringMask_ + 1;
+    const auto write = writeIndex_.load(std::memory_order_relaxed);
+    const auto start = write & ringMask_;
+    const auto count = std::min<std::uint64_t>(nFrames, capacity);
+    const auto first = std::min(count, capacity - start);
+
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        std::memcpy(ring_[ch].data() + start, data[ch], first * sizeof(float));
+        std::memcpy(ring_[ch].data(), data[ch] + first, (count - first) * sizeof(float));
+    }
+
+    writeIndex_.store(write + count, std::memory_order_release);
+}
+
+bool SpectrumAnalyzer::update() noexcept
+{
+    return magnitudes_.update();
+}
+
+const std::vector<float>& SpectrumAnalyzer::getMagnitudes() const noexcept
+{
+    return magnitudes_.front();
+}
+
+unsigned int SpectrumAnalyzer::getSampleRate() const noexcept
+{
+    return sampleRate_.load(std::memory_order_relaxed);
+}
+
+void SpectrumAnalyzer::workerLoop()
+{
+    const auto sampleRate = std::max(1u, sampleRate_.load(std::memory_order_relaxed));
+    const auto idle = std::chrono::microseconds(500'000ull * HOP_FRAMES / sampleRate);
+
+    std::uint64_t next = FFT_SIZE;
+    while (running_.load(std::memory_order_acquire)) {
+        const auto written = writeIndex_.load(std::memory_order_acquire);
+        if (written < next) {
+            std::this_thread::sleep_for(idle);
+            continue;
+        }
+
+        // the UI only shows the latest frame, there is no point in catching up
+        if (written - next > MAX_BACKLOG_FRAMES)
+            next = written;
+
+        if (copyLatest(next)) {
+            analyze();
+            magnitudes_.publish();
+        }
+        next += HOP_FRAMES;
+    }
+}
+
+bool SpectrumAnalyzer::copyLatest(std::uint64_t end) noexcept
+{
+    const auto begin = end - FFT_SIZE;
+    const auto gain = 1.0f / static_cast<float>(std::max(1u, numChannels_));
+
+    std::ranges::fill(frame_, 0.0f);
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        const auto& ring = ring_[ch];
+        for (auto i{0u}; i < FFT_SIZE; ++i)
+            frame_[i] += ring[(begin + i) & ringMask_];
+    }
+
+    // the audio thread got around the ring while we were copying (or is about to, with a
+    // buffer it has not published yet), the frame may be torn
+    const auto written = writeIndex_.load(std::memory_order_acquire);
+    if (written + maxFrames_ - begin > ringMask_ + 1)
+        return false;
+
+    for (auto i{0u}; i < FFT_SIZE; ++i)
+        frame_[i] *= gain * window_[i];
+    return true;
+}
+
+void SpectrumAnalyzer::analyze() noexcept
+{
+    kiss_fftr(plan_, frame_.data(), spectrum_.data());
+
+    auto& magnitudes = magnitudes_.back();
+    for (auto k{0u}; k < NUM_BINS; ++k) {
+        const auto magnitude = std::hypot(spectrum_[k].r, spectrum_[k].i) * normalization_;
+        magnitudes[k] = std::max(MIN_DB, 20.0f * std::log10(std::max(magnitude, 1e-9f)));
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <kiss_fftr.h>
+
+#include "triple_buffer.h"
+
+namespace fx {
+
+// Magnitude spectrum of the output for the UI.
+// The audio thread only copies its buffer into a ring (overwriting what was not analyzed in
+// time), a worker thread runs a Hann windowed real FFT every HOP_FRAMES and publishes the
+// magnitudes in dB through a triple buffer.
+class SpectrumAnalyzer
+{
+public:
+    static constexpr unsigned int FFT_SIZE = 2048;
+    static constexpr unsigned int HOP_FRAMES = 512;
+    static constexpr unsigned int NUM_BINS = FFT_SIZE / 2 + 1;
+    static constexpr float MIN_DB = -120.0f;
+
+    SpectrumAnalyzer();
+    ~SpectrumAnalyzer();
+
+    SpectrumAnalyzer(const SpectrumAnalyzer&) = delete;
+    SpectrumAnalyzer& operator=(const SpectrumAnalyzer&) = delete;
+
+    // Not real-time safe. (Re)starts the worker for the given format.
+    void prepare(unsigned int numChannels, unsigned int sampleRate, unsigned int maxFrames);
+    void stop();
+
+    // -- Audio thread --
+    void push(const float *const *data, unsigned int nFrames) noexcept;
+
+    // -- UI thread --
+    // Latest frame, NUM_BINS magnitudes in dB (0 dB is a full scale sine), true if it changed
+    bool update() noexcept;
+    const std::vector<float>& getMagnitudes() const noexcept;
+    unsigned int getSampleRate() const noexcept;
+
+private:
+    void workerLoop();
+    bool copyLatest(std::uint64_t end) noexcept;
+    void analyze() noexcept;
+
+    std::thread worker_;
+    std::atomic<bool> running_{false};
+    unsigned int numChannels_{0};
+    unsigned int maxFrames_{0};
+    std::atomic<unsigned int> sampleRate_{0};
+
+    // capture ring, written by the audio thread
+    std::vector<std::vector<float>> ring_;
+    std::uint64_t ringMask_{0};
+    std::atomic<std::uint64_t> writeIndex_{0};
+
+    // worker state
+    kiss_fftr_cfg plan_{nullptr};
+    std::vector<float> window_;
+    std::vector<float> frame_;
+    std::vector<kiss_fft_cpx> spectrum_;
+    float normalization_{1.0f};
+
+    TripleBuffer<std::vector<float>> magnitudes_;
+};
+
+} // namespace fx
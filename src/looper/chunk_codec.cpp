@@ -0,0 +1,255 @@
+#include "chunk_codec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace looper;
+
+static constexpr unsigned int SAMPLE_BITS = 20;
+static constexpr unsigned int MAX_ORDER = 3;
+static constexpr unsigned int PARTITION_FRAMES = 256;
+static constexpr unsigned int PARAMETER_BITS = 5;
+static constexpr unsigned int MAX_PARAMETER = 28;
+// a quotient this long is written as the escape followed by the value in full
+static constexpr unsigned int ESCAPE_QUOTIENT = 32;
+static constexpr int MIN_EXPONENT = -63;
+static constexpr int MAX_EXPONENT = 63;
+static constexpr std::uint8_t SILENT = 0x80;
+
+namespace {
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<std::uint8_t>& out) : out_(out) {}
+
+    void write(std::uint64_t value, unsigned int numBits)
+    {
+        for (auto i{numBits}; i-- > 0;)
+            writeBit(static_cast<unsigned int>(value >> i) & 1u);
+    }
+
+    void writeUnary(std::uint64_t count)
+    {
+        for (std::uint64_t i = 0; i < count; ++i)
+            writeBit(1);
+        writeBit(0);
+    }
+
+    void flush()
+    {
+        if (numBits_ > 0)
+            out_.push_back(static_cast<std::uint8_t>(byte_ << (8 - numBits_)));
+        numBits_ = 0;
+        byte_ = 0;
+    }
+
+private:
+    void writeBit(unsigned int bit)
+    {
+        byte_ = static_cast<std::uint8_t>((byte_ << 1) | bit);
+        if (++numBits_ == 8) {
+            out_.push_back(byte_);
+            numBits_ = 0;
+            byte_ = 0;
+        }
+    }
+
+    std::vector<std::uint8_t>& out_;
+    std::uint8_t byte_{0};
+    unsigned int numBits_{0};
+};
+
+class BitReader
+{
+public:
+    BitReader(const std::uint8_t* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    bool read(unsigned int numBits, std::uint64_t& value) noexcept
+    {
+        value = 0;
+        for (auto i{0u}; i < numBits; ++i) {
+            unsigned int bit = 0;
+            if (!readBit(bit)) return false;
+            value = (value << 1) | bit;
+        }
+        return true;
+    }
+
+    // stops after limit ones, the escape has no terminating zero
+    bool readUnary(unsigned int limit, std::uint64_t& count) noexcept
+    {
+        count = 0;
+        unsigned int bit = 0;
+        while (count < limit) {
+            if (!readBit(bit)) return false;
+            if (bit == 0) return true;
+            ++count;
+        }
+        return true;
+    }
+
+private:
+    bool readBit(unsigned int& bit) noexcept
+    {
+        if (position_ >= size_ * 8) return false;
+        bit = (data_[position_ >> 3] >> (7 - (position_ & 7))) & 1u;
+        ++position_;
+        return true;
+    }
+
+    const std::uint8_t* data_;
+    std::size_t size_;
+    std::size_t position_{0};
+};
+
+} // namespace
+
+static std::int64_t predict(const std::int32_t* q, unsigned int n, unsigned int order) noexcept
+{
+    // samples before the block start count as silence
+    const auto at = [&](unsigned int back) { return n >= back ? static_cast<std::int64_t>(q[n - back]) : 0; };
+    switch (order) {
+        case 1: return at(1);
+        case 2: return 2 * at(1) - at(2);
+        case 3: return 3 * at(1) - 3 * at(2) + at(3);
+        default: return 0;
+    }
+}
+
+static std::uint64_t zigzag(std::int64_t value) noexcept
+{
+    return value >= 0 ? static_cast<std::uint64_t>(value) << 1 : (static_cast<std::uint64_t>(-value) << 1) - 1;
+}
+
+static std::int64_t unzigzag(std::uint64_t value) noexcept
+{
+    return (value & 1) ? -static_cast<std::int64_t>((value + 1) >> 1) : static_cast<std::int64_t>(value >> 1);
+}
+
+static std::uint64_t riceCost(const std::uint64_t* values, unsigned int count, unsigned int parameter) noexcept
+{
+    std::uint64_t bits = 0;
+    for (auto i{0u}; i < count; ++i) {
+        const auto quotient = values[i] >> parameter;
+        bits += quotient >= ESCAPE_QUOTIENT ? ESCAPE_QUOTIENT + 64 : quotient + 1 + parameter;
+    }
+    return bits;
+}
+
+void looper::encodeChunk(const float* in, unsigned int numFrames, std::vector<std::uint8_t>& out)
+{
+    out.clear();
+
+    auto peak = 0.0f;
+    for (auto i{0u}; i < numFrames; ++i)
+        peak = std::max(peak, std::abs(in[i]));
+
+    // peak < 2^exponent, the SAMPLE_BITS range is spread over [-2^exponent, 2^exponent)
+    int exponent = 0;
+    std::frexp(peak, &exponent);
+    exponent = std::min(exponent, MAX_EXPONENT);
+
+    // far below anything audible counts as silence too
+    if (!(peak > 0.0f) || !std::isfinite(peak) || exponent < MIN_EXPONENT) {
+        out.push_back(SILENT);
+        return;
+    }
+    const auto scale = std::ldexp(1.0, static_cast<int>(SAMPLE_BITS) - 1 - exponent);
+    const auto limit = (1 << (SAMPLE_BITS - 1)) - 1;
+
+    std::vector<std::int32_t> q(numFrames);
+    for (auto i{0u}; i < numFrames; ++i)
+        q[i] = static_cast<std::int32_t>(std::clamp(std::lround(in[i] * scale), -static_cast<long>(limit) - 1, static_cast<long>(limit)));
+
+    // the predictor that leaves the least to code
+    auto order = 0u;
+    auto bestSum = ~std::uint64_t{0};
+    for (auto o{0u}; o <= MAX_ORDER; ++o) {
+        std::uint64_t sum = 0;
+        for (auto n{0u}; n < numFrames; ++n)
+            sum += static_cast<std::uint64_t>(std::llabs(q[n] - predict(q.data(), n, o)));
+        if (sum < bestSum) {
+            bestSum = sum;
+            order = o;
+        }
+    }
+
+    std::vector<std::uint64_t> residuals(numFrames);
+    for (auto n{0u}; n < numFrames; ++n)
+        residuals[n] = zigzag(q[n] - predict(q.data(), n, order));
+
+    out.push_back(static_cast<std::uint8_t>(exponent + 64));
+    out.push_back(static_cast<std::uint8_t>(order));
+
+    BitWriter writer(out);
+    for (auto first{0u}; first < numFrames; first += PARTITION_FRAMES) {
+        const auto count = std::min(PARTITION_FRAMES, numFrames - first);
+        const auto* values = residuals.data() + first;
+
+        auto parameter = 0u;
+        auto bestCost = riceCost(values, count, 0);
+        for (auto p{1u}; p <= MAX_PARAMETER; ++p) {
+            if (const auto cost = riceCost(values, count, p); cost < bestCost) {
+                bestCost = cost;
+                parameter = p;
+            }
+        }
+
+        writer.write(parameter, PARAMETER_BITS);
+        for (auto i{0u}; i < count; ++i) {
+            const auto quotient = values[i] >> parameter;
+            if (quotient >= ESCAPE_QUOTIENT) {
+                writer.write((std::uint64_t{1} << ESCAPE_QUOTIENT) - 1, ESCAPE_QUOTIENT);
+                writer.write(values[i], 64);
+            } else {
+                writer.writeUnary(quotient);
+                writer.write(values[i], parameter);
+            }
+        }
+    }
+    writer.flush();
+}
+
+bool looper::decodeChunk(const std::uint8_t* data, std::size_t size, float* out, unsigned int numFrames)
+{
+    if (size == 0) return false;
+    if (data[0] == SILENT) {
+        std::fill_n(out, numFrames, 0.0f);
+        return size == 1;
+    }
+    if (size < 2 || data[1] > MAX_ORDER) return false;
+
+    const auto exponent = static_cast<int>(data[0]) - 64;
+    const auto order = static_cast<unsigned int>(data[1]);
+    const auto scale = std::ldexp(1.0f, exponent + 1 - static_cast<int>(SAMPLE_BITS));
+
+    std::vector<std::int32_t> q(numFrames);
+
+    BitReader reader(data + 2, size - 2);
+    for (auto first{0u}; first < numFrames; first += PARTITION_FRAMES) {
+        const auto count = std::min(PARTITION_FRAMES, numFrames - first);
+
+        std::uint64_t parameter = 0;
+        if (!reader.read(PARAMETER_BITS, parameter) || parameter > MAX_PARAMETER) return false;
+
+        for (auto n{first}; n < first + count; ++n) {
+            std::uint64_t quotient = 0;
+            std::uint64_t value = 0;
+            if (!reader.readUnary(ESCAPE_QUOTIENT, quotient)) return false;
+            if (quotient == ESCAPE_QUOTIENT) {
+                if (!reader.read(64, value)) return false;
+            } else {
+                std::uint64_t remainder = 0;
+                if (!reader.read(static_cast<unsigned int>(parameter), remainder)) return false;
+                value = (quotient << parameter) | remainder;
+            }
+            q[n] = static_cast<std::int32_t>(unzigzag(value) + predict(q.data(), n, order));
+        }
+    }
+
+    for (auto n{0u}; n < numFrames; ++n)
+        out[n] = static_cast<float>(q[n]) * scale;
+    return true;
+}
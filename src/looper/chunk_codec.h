@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace looper {
+
+// Compact form of a block of loop audio for storage off the audio thread. Samples are
+// quantized to 20 bits below the block's peak (rounded up to a power of two, so quiet blocks
+// keep their resolution), predicted with the best of FLAC's fixed polynomial predictors and the
+// residuals Rice coded per partition. Silence takes one byte, music about half of its floats.
+//
+// The error stays within 2^-20 of the block's peak rounded up to a power of two (-120 dB of
+// that, -114 dB of the peak itself at worst). A decoded block encodes to the same bytes again,
+// so going through the codec repeatedly loses nothing more.
+
+// Not real-time safe, out is replaced with the encoded block
+void encodeChunk(const float* in, unsigned int numFrames, std::vector<std::uint8_t>& out);
+
+// Not real-time safe. False when data is not a block of numFrames frames.
+bool decodeChunk(const std::uint8_t* data, std::size_t size, float* out, unsigned int numFrames);
+
+} // namespace looper
@@ -0,0 +1,89 @@
+#include "chunk_compressor.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "chunk_codec.h"
+
+using namespace looper;
+
+// The worker polls instead of waiting on the mailbox, a post from the audio thread then never
+// has to wake it through the kernel. Jobs are not urgent, a layer is only warmed ahead of time.
+static constexpr auto POLL_INTERVAL = std::chrono::milliseconds(1);
+
+ChunkCompressor::~ChunkCompressor()
+{
+    stop();
+}
+
+void ChunkCompressor::start(unsigned int numHandles, unsigned int numFrames)
+{
+    stop();
+
+    store_.clear();
+    store_.resize(numHandles);
+    numFrames_ = numFrames;
+    compressedBytes_.store(0, std::memory_order_relaxed);
+
+    quit_.store(false, std::memory_order_relaxed);
+    worker_ = std::thread([this] { workerLoop(); });
+}
+
+void ChunkCompressor::stop()
+{
+    if (worker_.joinable()) {
+        quit_.store(true, std::memory_order_release);
+        worker_.join();
+    }
+
+    jobs_.consumeAll([](const Job&) {});
+    replies_.consumeAll([](const Job&) {});
+}
+
+bool ChunkCompressor::post(const Job& job) noexcept
+{
+    return jobs_.tryPush(job);
+}
+
+void ChunkCompressor::workerLoop()
+{
+    while (!quit_.load(std::memory_order_acquire)) {
+        Job job;
+        if (jobs_.tryPop(job))
+            run(job);
+        else
+            std::this_thread::sleep_for(POLL_INTERVAL);
+    }
+}
+
+void ChunkCompressor::run(const Job& job)
+{
+    if (job.handle >= store_.size()) return;
+    auto& stored = store_[job.handle];
+    const auto before = stored.capacity();
+
+    switch (job.op) {
+        case Op::ENCODE: {
+            encodeChunk(job.chunk, numFrames_, stored);
+            stored.shrink_to_fit();
+            break;
+        }
+        case Op::DECODE: {
+            if (!decodeChunk(stored.data(), stored.size(), job.chunk, numFrames_))
+                std::cerr << "Failed to decode loop chunk " << job.handle << std::endl;
+            break;
+        }
+        case Op::FREE: {
+            stored = {};
+            break;
+        }
+    }
+
+    compressedBytes_.fetch_add(stored.capacity() - before, std::memory_order_relaxed);
+    if (job.op == Op::FREE) return;
+
+    auto reply = job;
+    if (job.op == Op::ENCODE)
+        reply.bytes = static_cast<std::uint32_t>(stored.size());
+    replies_.tryPush(reply);
+}
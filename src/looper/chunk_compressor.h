@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "spsc_mailbox.h"
+
+namespace looper {
+
+// Worker that keeps chunks of loop audio in compressed form (see chunk_codec.h), each under
+// a handle the audio thread hands out. The audio thread only posts jobs and collects the
+// replies, encoding and decoding never run on it.
+//
+// A chunk passed with a job belongs to the worker until its reply comes back.
+class ChunkCompressor
+{
+public:
+    enum class Op : std::uint8_t
+    {
+        // compress chunk into handle, replied
+        ENCODE,
+        // decompress handle into chunk, replied
+        DECODE,
+        // drop what handle holds
+        FREE,
+    };
+
+    struct Job
+    {
+        Op op{Op::FREE};
+        unsigned int handle{0};
+        float* chunk{nullptr};
+        // set in the reply to ENCODE, size of the compressed copy
+        std::uint32_t bytes{0};
+    };
+
+    // Jobs waiting or in progress at any time, so replies always fit
+    static constexpr unsigned int MAX_JOBS = 64;
+
+    ChunkCompressor() = default;
+    ~ChunkCompressor();
+
+    ChunkCompressor(const ChunkCompressor&) = delete;
+    ChunkCompressor& operator=(const ChunkCompressor&) = delete;
+
+    // Not real-time safe. Drops everything stored and every job, then waits for numHandles
+    // handles of numFrames frames each.
+    void start(unsigned int numHandles, unsigned int numFrames);
+    // Not real-time safe, joins the worker. Replies to pending jobs are discarded.
+    void stop();
+
+    // -- Audio thread --
+    bool post(const Job& job) noexcept;
+
+    template <typename Fn>
+    void consumeReplies(Fn&& fn) noexcept
+    {
+        replies_.consumeAll(fn);
+    }
+
+    // Bytes held by the compressed chunks
+    std::size_t getCompressedBytes() const noexcept { return compressedBytes_.load(std::memory_order_relaxed); }
+
+private:
+    void workerLoop();
+    void run(const Job& job);
+
+    std::thread worker_;
+    std::atomic<bool> quit_{false};
+
+    SpscMailbox<Job> jobs_{MAX_JOBS};
+    SpscMailbox<Job> replies_{MAX_JOBS};
+
+    // worker state
+    std::vector<std::vector<std::uint8_t>> store_;
+    unsigned int numFrames_{0};
+    std::atomic<std::size_t> compressedBytes_{0};
+};
+
+} // namespace looper
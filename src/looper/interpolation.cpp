@@ -0,0 +1,236 @@
+#include "interpolation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+#include "../fx/halfband.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+    #include <xmmintrin.h>
+    #define LOOPER_SSE
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define LOOPER_NEON
+#endif
+
+namespace looper {
+
+static constexpr unsigned int SINC_TAPS = 2 * INTERPOLATION_MARGIN;
+static constexpr unsigned int SINC_PHASES = 256;
+// -6 dB point relative to Nyquist, and the Kaiser window's beta
+static constexpr double SINC_CUTOFF = 0.9;
+static constexpr double SINC_BETA = 8.0;
+
+// Row p holds the taps for a position p / SINC_PHASES past a frame, window order (oldest frame
+// first), the same layout as fx::Resampler. Row SINC_PHASES is row 0 one frame later.
+static std::vector<float> makeSincTable()
+{
+    constexpr auto halfTaps = static_cast<double>(INTERPOLATION_MARGIN);
+    std::vector<float> table(static_cast<std::size_t>(SINC_PHASES + 1) * SINC_TAPS);
+
+    const auto i0Beta = fx::besselI0(SINC_BETA);
+    for (auto p{0u}; p <= SINC_PHASES; ++p) {
+        const auto frac = static_cast<double>(p) / SINC_PHASES;
+        auto* row = table.data() + static_cast<std::size_t>(p) * SINC_TAPS;
+
+        double sum = 0.0;
+        for (auto i{0u}; i < SINC_TAPS; ++i) {
+            const auto t = frac + halfTaps - 1.0 - i;
+            const auto x = std::numbers::pi * SINC_CUTOFF * t;
+            const auto sinc = x == 0.0 ? 1.0 : std::sin(x) / x;
+            const auto r = t / halfTaps;
+            const auto window = fx::besselI0(SINC_BETA * std::sqrt(std::max(0.0, 1.0 - r * r))) / i0Beta;
+            row[i] = static_cast<float>(sinc * window);
+            sum += row[i];
+        }
+
+        // unity DC gain for every phase
+        for (auto i{0u}; i < SINC_TAPS; ++i)
+            row[i] = static_cast<float>(row[i] / sum);
+    }
+
+    return table;
+}
+
+// built before main, never on the audio thread
+static const std::vector<float> sincTable = makeSincTable();
+
+// Positions are computed from the block start instead of accumulated, so a long block at an
+// odd step does not drift. They are never negative, truncation is floor.
+static inline unsigned int split(double x, float& frac) noexcept
+{
+    const auto i = static_cast<unsigned int>(x);
+    frac = static_cast<float>(x - i);
+    return i;
+}
+
+static inline float cubic(float x0, float x1, float x2, float x3, float f) noexcept
+{
+    const auto c2 = 2.0f * x0 - 5.0f * x1 + 4.0f * x2 - x3;
+    const auto c3 = 3.0f * (x1 - x2) + x3 - x0;
+    return x1 + 0.5f * f * (x2 - x0 + f * (c2 + f * c3));
+}
+
+void interpolateLinear(const float* source, double position, double step, float* out, unsigned int n) noexcept
+{
+    unsigned int i = 0;
+
+#if defined(LOOPER_SSE) || defined(LOOPER_NEON)
+    // the four frames of a group are gathered, the rest is one vector op per step
+    for (; i + 4 <= n; i += 4) {
+        alignas(16) float a[4];
+        alignas(16) float b[4];
+        alignas(16) float f[4];
+        for (auto k{0u}; k < 4; ++k) {
+            const auto j = split(position + (i + k) * step, f[k]);
+            a[k] = source[j];
+            b[k] = source[j + 1];
+        }
+
+    #if defined(LOOPER_SSE)
+        const auto va = _mm_load_ps(a);
+        const auto y = _mm_add_ps(va, _mm_mul_ps(_mm_load_ps(f), _mm_sub_ps(_mm_load_ps(b), va)));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), y));
+    #else
+        const auto va = vld1q_f32(a);
+        const auto y = vmlaq_f32(va, vld1q_f32(f), vsubq_f32(vld1q_f32(b), va));
+        vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), y));
+    #endif
+    }
+#endif
+
+    for (; i < n; ++i) {
+        float f;
+        const auto j = split(position + i * step, f);
+        out[i] += source[j] + f * (source[j + 1] - source[j]);
+    }
+}
+
+void interpolateCubic(const float* source, double position, double step, float* out, unsigned int n) noexcept
+{
+    unsigned int i = 0;
+
+#if defined(LOOPER_SSE) || defined(LOOPER_NEON)
+    for (; i + 4 <= n; i += 4) {
+        alignas(16) float x[4][4];
+        alignas(16) float f[4];
+        for (auto k{0u}; k < 4; ++k) {
+            const auto j = split(position + (i + k) * step, f[k]);
+            for (auto t{0u}; t < 4; ++t)
+                x[t][k] = source[j - 1 + t];
+        }
+
+    #if defined(LOOPER_SSE)
+        const auto x0 = _mm_load_ps(x[0]);
+        const auto x1 = _mm_load_ps(x[1]);
+        const auto x2 = _mm_load_ps(x[2]);
+        const auto x3 = _mm_load_ps(x[3]);
+        const auto vf = _mm_load_ps(f);
+
+        // c2 = 2 x0 - 5 x1 + 4 x2 - x3, c3 = 3 (x1 - x2) + x3 - x0
+        const auto c2 = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.0f), x0), _mm_mul_ps(_mm_set1_ps(4.0f), x2)),
+                                   _mm_add_ps(_mm_mul_ps(_mm_set1_ps(5.0f), x1), x3));
+        const auto c3 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_sub_ps(x1, x2)), _mm_sub_ps(x3, x0));
+
+        auto y = _mm_add_ps(c2, _mm_mul_ps(vf, c3));
+        y = _mm_add_ps(_mm_sub_ps(x2, x0), _mm_mul_ps(vf, y));
+        y = _mm_add_ps(x1, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), vf), y));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), y));
+    #else
+        const auto x0 = vld1q_f32(x[0]);
+        const auto x1 = vld1q_f32(x[1]);
+        const auto x2 = vld1q_f32(x[2]);
+        const auto x3 = vld1q_f32(x[3]);
+        const auto vf = vld1q_f32(f);
+
+        const auto c2 = vsubq_f32(vmlaq_n_f32(vmulq_n_f32(x0, 2.0f), x2, 4.0f), vmlaq_n_f32(x3, x1, 5.0f));
+        const auto c3 = vmlaq_n_f32(vsubq_f32(x3, x0), vsubq_f32(x1, x2), 3.0f);
+
+        auto y = vmlaq_f32(c2, vf, c3);
+        y = vmlaq_f32(vsubq_f32(x2, x0), vf, y);
+        y = vmlaq_f32(x1, vmulq_n_f32(vf, 0.5f), y);
+        vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), y));
+    #endif
+    }
+#endif
+
+    for (; i < n; ++i) {
+        float f;
+        const auto j = split(position + i * step, f);
+        out[i] += cubic(source[j - 1], source[j], source[j + 1], source[j + 2], f);
+    }
+}
+
+void interpolateSinc(const float* source, double position, double step, float* out, unsigned int n) noexcept
+{
+    const auto* table = sincTable.data();
+
+    for (auto i{0u}; i < n; ++i) {
+        float frac;
+        const auto j = split(position + i * step, frac);
+        const auto phase = frac * SINC_PHASES;
+        const auto p = std::min(static_cast<unsigned int>(phase), SINC_PHASES - 1);
+        const auto a = phase - static_cast<float>(p);
+
+        const auto* window = source + j - (INTERPOLATION_MARGIN - 1);
+        const auto* row0 = table + static_cast<std::size_t>(p) * SINC_TAPS;
+        const auto* row1 = row0 + SINC_TAPS;
+        unsigned int t = 0;
+        float y = 0.0f;
+
+        // taps between the two nearest phases, times the window
+#if defined(LOOPER_SSE)
+        const auto va = _mm_set1_ps(a);
+        auto acc = _mm_setzero_ps();
+        for (; t + 4 <= SINC_TAPS; t += 4) {
+            const auto r0 = _mm_loadu_ps(row0 + t);
+            const auto taps = _mm_add_ps(r0, _mm_mul_ps(va, _mm_sub_ps(_mm_loadu_ps(row1 + t), r0)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(taps, _mm_loadu_ps(window + t)));
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, acc);
+        y = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(LOOPER_NEON)
+        auto acc = vdupq_n_f32(0.0f);
+        for (; t + 4 <= SINC_TAPS; t += 4) {
+            const auto r0 = vld1q_f32(row0 + t);
+            const auto taps = vmlaq_n_f32(r0, vsubq_f32(vld1q_f32(row1 + t), r0), a);
+            acc = vmlaq_f32(acc, taps, vld1q_f32(window + t));
+        }
+
+        float lanes[4];
+        vst1q_f32(lanes, acc);
+        y = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+        for (; t < SINC_TAPS; ++t)
+            y += (row0[t] + a * (row1[t] - row0[t])) * window[t];
+
+        out[i] += y;
+    }
+}
+
+void interpolate(Interpolation mode, const float* source, double position, double step, float* out,
+                 unsigned int n) noexcept
+{
+    switch (mode) {
+        case Interpolation::LINEAR: interpolateLinear(source, position, step, out, n); break;
+        case Interpolation::CUBIC: interpolateCubic(source, position, step, out, n); break;
+        case Interpolation::SINC: interpolateSinc(source, position, step, out, n); break;
+    }
+}
+
+const char* interpolationToStr(Interpolation mode) noexcept
+{
+    switch (mode) {
+        case Interpolation::LINEAR: return "linear";
+        case Interpolation::CUBIC: return "cubic";
+        case Interpolation::SINC: return "sinc";
+    }
+    return "?";
+}
+
+} // namespace looper
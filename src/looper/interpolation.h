@@ -0,0 +1,36 @@
+#pragma once
+
+namespace looper {
+
+// Fractional reads from the loop for playback at another speed or backwards. The kernels work
+// on whole blocks of a contiguous copy of the frames around the read positions, SSE or NEON
+// where available: linear and cubic four output frames at a time, sinc four taps at a time.
+//
+// The sinc kernel is a fixed band-limited interpolator, it does not follow the speed. Played
+// faster than recorded, whatever ends up above the output Nyquist frequency folds back, as
+// it does with the other two.
+enum class Interpolation
+{
+    LINEAR,
+    CUBIC,
+    SINC,
+};
+
+// Frames a kernel reads around a position, source[j - MARGIN + 1 .. j + MARGIN] for the frame j
+// at or before it
+static constexpr unsigned int INTERPOLATION_MARGIN = 8;
+
+// out[i] += source(position + i * step) for i < n, step may be negative. Every position has to
+// lie within [INTERPOLATION_MARGIN - 1, size - INTERPOLATION_MARGIN) of the source.
+void interpolateLinear(const float* source, double position, double step, float* out, unsigned int n) noexcept;
+// Catmull-Rom spline through the four nearest frames
+void interpolateCubic(const float* source, double position, double step, float* out, unsigned int n) noexcept;
+// Kaiser windowed sinc, 2 * INTERPOLATION_MARGIN taps, the phases in between linearly interpolated
+void interpolateSinc(const float* source, double position, double step, float* out, unsigned int n) noexcept;
+
+void interpolate(Interpolation mode, const float* source, double position, double step, float* out,
+                 unsigned int n) noexcept;
+
+const char* interpolationToStr(Interpolation mode) noexcept;
+
+} // namespace looper
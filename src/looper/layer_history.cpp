@@ -0,0 +1,301 @@
+#include "layer_history.h"
+
+#include <algorithm>
+
+using namespace looper;
+
+void LayerHistory::prepare(unsigned int numSlots, std::size_t maxCompressedBytes)
+{
+    reset();
+
+    // a layer touches every slot at most once, entries never reallocate on the audio thread
+    for (auto& layer : layers_)
+        layer.entries.reserve(numSlots);
+
+    savedIn_.assign(numSlots, 0);
+    serial_ = 0;
+
+    // every entry of every layer may hold a compressed copy
+    const auto numHandles = MAX_LAYERS * numSlots;
+    owners_.assign(numHandles, Owner{});
+    handleBytes_.assign(numHandles, 0);
+    compressedBytes_ = 0;
+    maxCompressedBytes_ = maxCompressedBytes;
+    freeHandles_.clear();
+    freeHandles_.reserve(numHandles);
+    unfreed_.clear();
+    unfreed_.reserve(numHandles);
+    for (auto h{numHandles}; h-- > 0;)
+        freeHandles_.push_back(h);
+
+    if (numSlots > 0)
+        compressor_.start(numHandles, LoopBuffer::CHUNK_FRAMES);
+}
+
+void LayerHistory::reset()
+{
+    compressor_.stop();
+
+    for (auto& layer : layers_) {
+        layer.entries.clear();
+        layer.numPending = 0;
+        layer.numCold = 0;
+    }
+
+    first_ = 0;
+    numApplied_ = 0;
+    numRedo_ = 0;
+    waitingSteps_ = 0;
+    open_ = false;
+    tracking_ = false;
+    numInFlight_ = 0;
+    std::fill(handleBytes_.begin(), handleBytes_.end(), 0u);
+    compressedBytes_ = 0;
+}
+
+void LayerHistory::beginLayer(LoopBuffer& buffers) noexcept
+{
+    if (open_ || savedIn_.empty()) return;
+
+    // steps still waiting for a decode are dropped with the redo side
+    waitingSteps_ = 0;
+    for (auto r{0u}; r < numRedo_; ++r)
+        release(buffers, layerAt(numApplied_ + r));
+    numRedo_ = 0;
+
+    if (numApplied_ == MAX_LAYERS)
+        flattenOldest(buffers);
+
+    if (++serial_ == 0) {
+        std::fill(savedIn_.begin(), savedIn_.end(), 0u);
+        serial_ = 1;
+    }
+
+    layerAt(numApplied_).entries.clear();
+    open_ = true;
+    tracking_ = true;
+}
+
+void LayerHistory::endLayer() noexcept
+{
+    if (!open_) return;
+    open_ = false;
+
+    // a pass that never wrote anything (or lost its copies) leaves nothing to undo
+    if (tracking_ && !layerAt(numApplied_).entries.empty())
+        ++numApplied_;
+    tracking_ = false;
+}
+
+void LayerHistory::prepareWrite(LoopBuffer& buffers, unsigned int first, unsigned int count) noexcept
+{
+    if (!tracking_ || count == 0 || first >= buffers.getNumFrames()) return;
+
+    const auto last = std::min(first + count, buffers.getNumFrames()) - 1;
+    auto& layer = layerAt(numApplied_);
+
+    for (auto ch{0u}; ch < buffers.getNumChannels(); ++ch) {
+        for (auto c{first >> LoopBuffer::CHUNK_SHIFT}; c <= last >> LoopBuffer::CHUNK_SHIFT; ++c) {
+            const auto slot = buffers.getSlot(ch, c);
+            if (savedIn_[slot] == serial_) continue;
+
+            auto* chunk = buffers.acquireChunk();
+            while (!chunk && flattenOldest(buffers))
+                chunk = buffers.acquireChunk();
+
+            // out of memory even with no history left, this pass can not be undone
+            if (!chunk) {
+                release(buffers, layer);
+                tracking_ = false;
+                return;
+            }
+
+            std::copy_n(buffers.chunkAt(slot), LoopBuffer::CHUNK_FRAMES, chunk);
+            layer.entries.push_back({slot, chunk});
+            savedIn_[slot] = serial_;
+        }
+    }
+}
+
+void LayerHistory::service(LoopBuffer& buffers) noexcept
+{
+    if (owners_.empty()) return;
+
+    collectReplies(buffers);
+    retryFrees();
+
+    // past the budget the oldest idle layers are merged into the loop, never one an undo needs
+    while (compressedBytes_ > maxCompressedBytes_
+           && numApplied_ > HOT_LAYERS + static_cast<unsigned int>(std::max(waitingSteps_, 0)))
+        flattenOldest(buffers);
+
+    auto budget = JOBS_PER_SERVICE;
+    const auto numLayers = numApplied_ + numRedo_;
+
+    // the next undo first, then the next redo, then whatever went idle
+    for (auto i{0u}; i < HOT_LAYERS; ++i) {
+        if (numApplied_ > i)
+            warm(buffers, layerAt(numApplied_ - 1 - i), budget);
+        if (numRedo_ > i)
+            warm(buffers, layerAt(numApplied_ + i), budget);
+    }
+
+    // the open layer is never compressed, it is the next undo as soon as it ends
+    for (auto l{0u}; l < numLayers; ++l) {
+        if (!isHot(l))
+            cool(buffers, l, budget);
+    }
+}
+
+void LayerHistory::clear(LoopBuffer& buffers) noexcept
+{
+    const auto numLayers = numApplied_ + numRedo_ + (open_ ? 1u : 0u);
+    for (auto l{0u}; l < numLayers; ++l)
+        release(buffers, layerAt(l));
+
+    first_ = 0;
+    numApplied_ = 0;
+    numRedo_ = 0;
+    waitingSteps_ = 0;
+    open_ = false;
+    tracking_ = false;
+}
+
+void LayerHistory::release(LoopBuffer& buffers, Layer& layer) noexcept
+{
+    for (const auto& entry : layer.entries) {
+        // the chunk comes back with the reply
+        if (entry.pending) {
+            owners_[entry.handle].layer = ORPHAN;
+            continue;
+        }
+        buffers.releaseChunk(entry.chunk);
+        freeHandle(entry.handle);
+    }
+
+    layer.entries.clear();
+    layer.numPending = 0;
+    layer.numCold = 0;
+}
+
+bool LayerHistory::flattenOldest(LoopBuffer& buffers) noexcept
+{
+    if (numApplied_ == 0) return false;
+
+    // the loop already holds the result of the oldest pass, only its copies go
+    release(buffers, layerAt(0));
+    first_ = (first_ + 1) % MAX_LAYERS;
+    --numApplied_;
+    waitingSteps_ = std::min(waitingSteps_, static_cast<int>(numApplied_));
+    return true;
+}
+
+void LayerHistory::collectReplies(LoopBuffer& buffers) noexcept
+{
+    compressor_.consumeReplies([&](const ChunkCompressor::Job& job) {
+        --numInFlight_;
+
+        if (job.op == ChunkCompressor::Op::ENCODE) {
+            handleBytes_[job.handle] = job.bytes;
+            compressedBytes_ += job.bytes;
+        }
+
+        const auto owner = owners_[job.handle];
+        if (owner.layer == ORPHAN) {
+            buffers.releaseChunk(job.chunk);
+            freeHandle(job.handle);
+            return;
+        }
+
+        // an encoded chunk stays until cool() lets it go, a decoded one is hot again
+        auto& layer = layers_[owner.layer];
+        layer.entries[owner.entry].pending = false;
+        --layer.numPending;
+    });
+}
+
+void LayerHistory::warm(LoopBuffer& buffers, Layer& layer, unsigned int& budget) noexcept
+{
+    if (layer.numCold == 0) return;
+
+    for (auto& entry : layer.entries) {
+        if (entry.chunk) continue;
+        if (budget == 0) return;
+
+        // decoding needs a spare chunk to decode into, there is one again once a pass ends
+        auto* chunk = buffers.acquireChunk();
+        if (!chunk) return;
+        if (!postJob(ChunkCompressor::Op::DECODE, entry.handle, chunk, budget)) {
+            buffers.releaseChunk(chunk);
+            return;
+        }
+
+        entry.chunk = chunk;
+        entry.pending = true;
+        --layer.numCold;
+        ++layer.numPending;
+    }
+}
+
+void LayerHistory::cool(LoopBuffer& buffers, unsigned int index, unsigned int& budget) noexcept
+{
+    auto& layer = layerAt(index);
+    if (layer.entries.size() == layer.numPending + layer.numCold) return;
+
+    for (auto e{0u}; e < layer.entries.size(); ++e) {
+        auto& entry = layer.entries[e];
+        if (!entry.chunk || entry.pending) continue;
+
+        // encoded before, nothing changed since
+        if (entry.handle != NO_HANDLE) {
+            buffers.releaseChunk(entry.chunk);
+            entry.chunk = nullptr;
+            ++layer.numCold;
+            continue;
+        }
+
+        if (budget == 0 || freeHandles_.empty()) return;
+        const auto handle = freeHandles_.back();
+        if (!postJob(ChunkCompressor::Op::ENCODE, handle, entry.chunk, budget)) return;
+
+        freeHandles_.pop_back();
+        owners_[handle] = Owner{physicalIndex(index), e};
+        entry.handle = handle;
+        entry.pending = true;
+        ++layer.numPending;
+    }
+}
+
+bool LayerHistory::postJob(ChunkCompressor::Op op, unsigned int handle, float* chunk, unsigned int& budget) noexcept
+{
+    // replies have room for every job in flight
+    if (numInFlight_ == ChunkCompressor::MAX_JOBS) return false;
+    if (!compressor_.post({op, handle, chunk})) return false;
+
+    ++numInFlight_;
+    --budget;
+    return true;
+}
+
+void LayerHistory::freeHandle(unsigned int handle) noexcept
+{
+    if (handle == NO_HANDLE) return;
+
+    compressedBytes_ -= handleBytes_[handle];
+    handleBytes_[handle] = 0;
+
+    // The worker drops the stored bytes. The handle is only reused once it was told to, with
+    // the job mailbox full it waits for the next service().
+    if (compressor_.post({ChunkCompressor::Op::FREE, handle, nullptr}))
+        freeHandles_.push_back(handle);
+    else
+        unfreed_.push_back(handle);
+}
+
+void LayerHistory::retryFrees() noexcept
+{
+    while (!unfreed_.empty() && compressor_.post({ChunkCompressor::Op::FREE, unfreed_.back(), nullptr})) {
+        freeHandles_.push_back(unfreed_.back());
+        unfreed_.pop_back();
+    }
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "chunk_compressor.h"
+#include "loop_buffer.h"
+
+namespace looper {
+
+// Undo/redo of overdub passes, one layer per pass. A layer only holds the chunks the pass
+// touched: the first write to a chunk copies it into a spare chunk (copy-on-write), which keeps
+// what the chunk held before the pass. Undo and redo exchange those chunks with the ones in the
+// loop, so either way costs one pointer swap per touched chunk, no matter how long the loop is.
+//
+// Only the layers next to the current position (the next undo and the next redo) are kept as
+// spare chunks. The others are idle, a worker compresses them and their spare chunks go back to
+// the pool. Once a layer moves next to the position again it is decoded back into spare chunks
+// in the background. An undo or redo that reaches it before that waits and happens as soon as
+// it is decoded.
+//
+// The spare chunks only ever hold the hot layers, SPARE_LAYERS loops worth of them. Compressed
+// layers count against a byte budget instead, past it the oldest layers are flattened (merged
+// into the loop). When spare chunks run out the oldest layers are flattened too, and as a last
+// resort the pass being recorded stops being undoable.
+class LayerHistory
+{
+public:
+    static constexpr unsigned int MAX_LAYERS = 16;
+    // Layers on either side of the position that stay decoded
+    static constexpr unsigned int HOT_LAYERS = 1;
+    // Full loops of spare chunks the hot layers can take: while recording the open layer and
+    // the next undo, otherwise the next undo and the next redo
+    static constexpr unsigned int SPARE_LAYERS = 2 * HOT_LAYERS;
+
+    // Not real-time safe, starts the compressor. Idle layers may keep up to maxCompressedBytes
+    // of compressed copies.
+    void prepare(unsigned int numSlots, std::size_t maxCompressedBytes);
+    // Not real-time safe. Stops the compressor and forgets every layer without returning
+    // its chunks, for when the loop buffer goes away.
+    void reset();
+
+    // -- Audio thread --
+    // Starts a layer, dropping whatever could have been redone
+    void beginLayer(LoopBuffer& buffers) noexcept;
+    void endLayer() noexcept;
+
+    // Saves the chunks holding frames [first, first + count) of every channel before the open
+    // layer writes them for the first time
+    void prepareWrite(LoopBuffer& buffers, unsigned int first, unsigned int count) noexcept;
+
+    // Collects finished compressor jobs and hands it the next ones, once per buffer, followed
+    // by applyWaiting()
+    void service(LoopBuffer& buffers) noexcept;
+
+    // Calls changed(slot) for every slot that now holds a different chunk, right away or, while
+    // the layer is still being decoded, from a later applyWaiting(). False when there is nothing
+    // (left) to undo or redo.
+    template <typename Changed>
+    bool undo(LoopBuffer& buffers, Changed&& changed) noexcept
+    {
+        if (open_ || static_cast<int>(numApplied_) - waitingSteps_ <= 0) return false;
+        ++waitingSteps_;
+        applyWaiting(buffers, changed);
+        return true;
+    }
+
+    template <typename Changed>
+    bool redo(LoopBuffer& buffers, Changed&& changed) noexcept
+    {
+        if (open_ || static_cast<int>(numRedo_) + waitingSteps_ <= 0) return false;
+        --waitingSteps_;
+        applyWaiting(buffers, changed);
+        return true;
+    }
+
+    // Steps that waited for their layer to be decoded, as far as it is
+    template <typename Changed>
+    void applyWaiting(LoopBuffer& buffers, Changed&& changed) noexcept
+    {
+        while (waitingSteps_ > 0 && numApplied_ > 0 && isReady(layerAt(numApplied_ - 1))) {
+            --numApplied_;
+            ++numRedo_;
+            swap(buffers, layerAt(numApplied_), changed);
+            --waitingSteps_;
+        }
+
+        while (waitingSteps_ < 0 && numRedo_ > 0 && isReady(layerAt(numApplied_))) {
+            swap(buffers, layerAt(numApplied_), changed);
+            ++numApplied_;
+            --numRedo_;
+            ++waitingSteps_;
+        }
+    }
+
+    // Returns every saved chunk to the pool
+    void clear(LoopBuffer& buffers) noexcept;
+
+    unsigned int getNumUndo() const noexcept { return numApplied_; }
+    unsigned int getNumRedo() const noexcept { return numRedo_; }
+    // Compressed copies of the layers, what counts against the budget
+    std::size_t getCompressedBytes() const noexcept { return compressedBytes_; }
+
+private:
+    static constexpr unsigned int NO_HANDLE = ~0u;
+    // New compressor jobs per buffer, spreads a layer's worth of requests over a few buffers
+    static constexpr unsigned int JOBS_PER_SERVICE = 16;
+
+    // A saved chunk is hot (chunk, no job), in flight (chunk, pending) or cold (no chunk, only
+    // the compressed copy under handle). A hot chunk that still has its handle can go cold again
+    // without being encoded.
+    struct Entry
+    {
+        unsigned int slot{0};
+        float* chunk{nullptr};
+        unsigned int handle{NO_HANDLE};
+        bool pending{false};
+    };
+
+    struct Layer
+    {
+        std::vector<Entry> entries;
+        unsigned int numPending{0};
+        unsigned int numCold{0};
+    };
+
+    // where the reply for a handle goes, the layer is a physical index, ORPHAN when the
+    // entry was dropped while its job was in flight
+    struct Owner
+    {
+        unsigned int layer{0};
+        unsigned int entry{0};
+    };
+    static constexpr unsigned int ORPHAN = MAX_LAYERS;
+
+    Layer& layerAt(unsigned int index) noexcept { return layers_[physicalIndex(index)]; }
+    unsigned int physicalIndex(unsigned int index) const noexcept { return (first_ + index) % MAX_LAYERS; }
+    static bool isReady(const Layer& layer) noexcept { return layer.numPending == 0 && layer.numCold == 0; }
+    bool isHot(unsigned int index) const noexcept
+    {
+        return index + HOT_LAYERS >= numApplied_ && index < numApplied_ + HOT_LAYERS;
+    }
+
+    template <typename Changed>
+    void swap(LoopBuffer& buffers, Layer& layer, Changed& changed) noexcept
+    {
+        for (auto& entry : layer.entries) {
+            // the compressed copy is of what the layer held before the swap
+            freeHandle(entry.handle);
+            entry.handle = NO_HANDLE;
+            entry.chunk = buffers.exchange(entry.slot, entry.chunk);
+            changed(entry.slot);
+        }
+    }
+
+    void release(LoopBuffer& buffers, Layer& layer) noexcept;
+    bool flattenOldest(LoopBuffer& buffers) noexcept;
+    void collectReplies(LoopBuffer& buffers) noexcept;
+    void warm(LoopBuffer& buffers, Layer& layer, unsigned int& budget) noexcept;
+    void cool(LoopBuffer& buffers, unsigned int index, unsigned int& budget) noexcept;
+    bool postJob(ChunkCompressor::Op op, unsigned int handle, float* chunk, unsigned int& budget) noexcept;
+    void freeHandle(unsigned int handle) noexcept;
+    void retryFrees() noexcept;
+
+    std::array<Layer, MAX_LAYERS> layers_;
+    unsigned int first_{0};
+    unsigned int numApplied_{0};
+    unsigned int numRedo_{0};
+    // undo steps (negative: redo steps) waiting for their layer to be decoded
+    int waitingSteps_{0};
+
+    // the open layer is the one after the applied ones
+    bool open_{false};
+    bool tracking_{false};
+
+    // serial of the layer that last saved each slot, a new layer never matches
+    std::vector<std::uint32_t> savedIn_;
+    std::uint32_t serial_{0};
+
+    std::vector<Owner> owners_;
+    // size of the compressed copy under each handle, as the replies report it
+    std::vector<std::uint32_t> handleBytes_;
+    std::size_t compressedBytes_{0};
+    std::size_t maxCompressedBytes_{0};
+    std::vector<unsigned int> freeHandles_;
+    // released handles whose FREE job did not fit into the mailbox yet
+    std::vector<unsigned int> unfreed_;
+    unsigned int numInFlight_{0};
+
+    // last, its worker writes the chunks of pending entries until it is stopped
+    ChunkCompressor compressor_;
+};
+
+} // namespace looper
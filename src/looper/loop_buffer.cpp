@@ -0,0 +1,129 @@
+#include "loop_buffer.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace looper;
+
+LoopBuffer::~LoopBuffer()
+{
+    release();
+}
+
+LoopBuffer::LoopBuffer(LoopBuffer&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+LoopBuffer& LoopBuffer::operator=(LoopBuffer&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        block_ = std::exchange(other.block_, {});
+        table_ = std::move(other.table_);
+        free_ = std::move(other.free_);
+        numChannels_ = std::exchange(other.numChannels_, 0);
+        numFrames_ = std::exchange(other.numFrames_, 0);
+        numChunks_ = std::exchange(other.numChunks_, 0);
+        locked_ = std::exchange(other.locked_, false);
+        prefaultCount_ = std::exchange(other.prefaultCount_, 0);
+    }
+    return *this;
+}
+
+bool LoopBuffer::allocate(unsigned int numChannels, unsigned int numFrames, unsigned int numSpareChunks)
+{
+    release();
+    if (numChannels == 0 || numFrames == 0) return true;
+
+    const auto numChunks = (numFrames + CHUNK_MASK) >> CHUNK_SHIFT;
+    const auto numSlots = static_cast<std::size_t>(numChannels) * numChunks;
+    const auto totalChunks = numSlots + numSpareChunks;
+
+    block_ = memory::allocatePages(totalChunks * CHUNK_FRAMES * sizeof(float), true);
+    if (!block_.data) return false;
+
+    // fresh anonymous pages read as zeros, touching them is all the clearing they need
+    const auto faultsBefore = memory::minorFaultCount();
+    memory::prefault(block_.data, block_.size);
+    prefaultCount_ = memory::minorFaultCount() - faultsBefore;
+    locked_ = memory::lockPages(block_.data, block_.size);
+
+    auto* chunks = static_cast<float*>(block_.data);
+    table_ = std::make_unique<std::atomic<float*>[]>(numSlots);
+    for (std::size_t s = 0; s < numSlots; ++s)
+        table_[s].store(chunks + s * CHUNK_FRAMES, std::memory_order_relaxed);
+
+    // every chunk may end up outside the table at some point, the free list never reallocates
+    free_.reserve(totalChunks);
+    for (auto s{numSlots}; s < totalChunks; ++s)
+        free_.push_back(chunks + s * CHUNK_FRAMES);
+
+    numChannels_ = numChannels;
+    numFrames_ = numFrames;
+    numChunks_ = numChunks;
+    return true;
+}
+
+void LoopBuffer::release() noexcept
+{
+    // unmapping unlocks the pages as well
+    memory::freePages(block_);
+    table_.reset();
+    free_ = {};
+    numChannels_ = 0;
+    numFrames_ = 0;
+    numChunks_ = 0;
+    locked_ = false;
+    prefaultCount_ = 0;
+}
+
+void LoopBuffer::zero(unsigned int first, unsigned int count) noexcept
+{
+    count = std::min(count, numFrames_ - std::min(first, numFrames_));
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        for (auto frame{first}; frame < first + count;) {
+            const auto n = std::min(first + count - frame, CHUNK_FRAMES - (frame & CHUNK_MASK));
+            std::fill_n(&at(ch, frame), n, 0.0f);
+            frame += n;
+        }
+    }
+}
+
+float* LoopBuffer::exchange(unsigned int slot, float* chunk) noexcept
+{
+    return table_[slot].exchange(chunk, std::memory_order_relaxed);
+}
+
+float* LoopBuffer::acquireChunk() noexcept
+{
+    if (free_.empty()) return nullptr;
+    auto* chunk = free_.back();
+    free_.pop_back();
+    return chunk;
+}
+
+void LoopBuffer::releaseChunk(float* chunk) noexcept
+{
+    if (chunk)
+        free_.push_back(chunk);
+}
+
+void LoopBuffer::read(unsigned int channel, unsigned int first, unsigned int count, float* out) const noexcept
+{
+    for (auto frame{first}; frame < first + count;) {
+        const auto n = std::min(first + count - frame, CHUNK_FRAMES - (frame & CHUNK_MASK));
+        const auto* chunk = chunkAt(slotOf(channel, frame)) + (frame & CHUNK_MASK);
+        std::copy_n(chunk, n, out + (frame - first));
+        frame += n;
+    }
+}
+
+void LoopBuffer::write(unsigned int channel, unsigned int first, unsigned int count, const float* in) noexcept
+{
+    for (auto frame{first}; frame < first + count;) {
+        const auto n = std::min(first + count - frame, CHUNK_FRAMES - (frame & CHUNK_MASK));
+        std::copy_n(in + (frame - first), n, &at(channel, frame));
+        frame += n;
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "memory/page_memory.h"
+
+namespace looper {
+
+// The loop as a table of fixed size chunks per channel, all carved from one page backed block
+// (huge pages where the system has them) that is prefaulted and locked in RAM when allocated,
+// so recording never takes a page fault on the audio thread.
+//
+// Spare chunks beyond the ones the table starts with let the owner swap chunks in and out
+// (copy-on-write layers) by exchanging pointers. Table entries are atomic, so workers reading
+// the loop see either the old or the new chunk, never a torn pointer.
+class LoopBuffer
+{
+public:
+    static constexpr unsigned int CHUNK_SHIFT = 12;
+    static constexpr unsigned int CHUNK_FRAMES = 1u << CHUNK_SHIFT;
+    static constexpr unsigned int CHUNK_MASK = CHUNK_FRAMES - 1;
+
+    LoopBuffer() = default;
+    ~LoopBuffer();
+
+    LoopBuffer(LoopBuffer&& other) noexcept;
+    LoopBuffer& operator=(LoopBuffer&& other) noexcept;
+
+    LoopBuffer(const LoopBuffer&) = delete;
+    LoopBuffer& operator=(const LoopBuffer&) = delete;
+
+    // Not real-time safe. Zeroed, returns false when out of memory.
+    bool allocate(unsigned int numChannels, unsigned int numFrames, unsigned int numSpareChunks = 0);
+    void release() noexcept;
+
+    // -- Audio thread (reads from any thread) --
+    float& at(unsigned int channel, unsigned int frame) noexcept
+    {
+        return chunkAt(slotOf(channel, frame))[frame & CHUNK_MASK];
+    }
+
+    float at(unsigned int channel, unsigned int frame) const noexcept
+    {
+        return chunkAt(slotOf(channel, frame))[frame & CHUNK_MASK];
+    }
+
+    // Zeroes frames [first, first + count) of every channel
+    void zero(unsigned int first, unsigned int count) noexcept;
+
+    // A slot is one chunk of one channel, chunk index i of channel c is slot c * getNumChunks() + i
+    unsigned int getNumSlots() const noexcept { return numChannels_ * numChunks_; }
+    unsigned int getSlot(unsigned int channel, unsigned int chunk) const noexcept { return channel * numChunks_ + chunk; }
+    float* chunkAt(unsigned int slot) const noexcept { return table_[slot].load(std::memory_order_relaxed); }
+    // Puts chunk into slot and returns the one that was there
+    float* exchange(unsigned int slot, float* chunk) noexcept;
+
+    // Spare chunks, nullptr when there are none left
+    float* acquireChunk() noexcept;
+    void releaseChunk(float* chunk) noexcept;
+    unsigned int getNumFreeChunks() const noexcept { return static_cast<unsigned int>(free_.size()); }
+
+    // -- Workers, contiguous copies of frames [first, first + count) of a channel --
+    void read(unsigned int channel, unsigned int first, unsigned int count, float* out) const noexcept;
+    void write(unsigned int channel, unsigned int first, unsigned int count, const float* in) noexcept;
+
+    unsigned int getNumChannels() const noexcept { return numChannels_; }
+    unsigned int getNumFrames() const noexcept { return numFrames_; }
+    unsigned int getNumChunks() const noexcept { return numChunks_; }
+    bool empty() const noexcept { return numChannels_ == 0; }
+
+    // -- Diagnostics --
+    std::size_t getSizeInBytes() const noexcept { return block_.size; }
+    bool usesHugePages() const noexcept { return block_.hugePages; }
+    bool isLocked() const noexcept { return locked_; }
+    // minor page faults allocate() took up front, instead of the first pass
+    long getPrefaultCount() const noexcept { return prefaultCount_; }
+
+private:
+    unsigned int slotOf(unsigned int channel, unsigned int frame) const noexcept
+    {
+        return channel * numChunks_ + (frame >> CHUNK_SHIFT);
+    }
+
+    memory::PageBlock block_;
+    std::unique_ptr<std::atomic<float*>[]> table_;
+    std::vector<float*> free_;
+    unsigned int numChannels_{0};
+    unsigned int numFrames_{0};
+    unsigned int numChunks_{0};
+    bool locked_{false};
+    long prefaultCount_{0};
+};
+
+} // namespace looper
@@ -0,0 +1,74 @@
+#include "loop_kernels.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+    #include <xmmintrin.h>
+    #define LOOPER_SSE
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define LOOPER_NEON
+#endif
+
+namespace looper {
+
+void recordFrames(float* loop, const float* in, const float* gains, unsigned int n) noexcept
+{
+    unsigned int i = 0;
+
+#if defined(LOOPER_SSE)
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(loop + i, _mm_mul_ps(_mm_loadu_ps(gains + i), _mm_loadu_ps(in + i)));
+#elif defined(LOOPER_NEON)
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(loop + i, vmulq_f32(vld1q_f32(gains + i), vld1q_f32(in + i)));
+#endif
+
+    for (; i < n; ++i)
+        loop[i] = gains[i] * in[i];
+}
+
+void overdubFrames(const float* read, float* write, float* io, const float* gains, unsigned int n) noexcept
+{
+    unsigned int i = 0;
+
+    // the old frames are loaded before anything in this group is stored, a write trailing the
+    // read by less than a group still sees what it has to add to
+#if defined(LOOPER_SSE)
+    for (; i + 4 <= n; i += 4) {
+        const auto old = _mm_loadu_ps(read + i);
+        const auto input = _mm_loadu_ps(io + i);
+        _mm_storeu_ps(write + i, _mm_add_ps(_mm_loadu_ps(write + i), _mm_mul_ps(_mm_loadu_ps(gains + i), input)));
+        _mm_storeu_ps(io + i, _mm_add_ps(input, old));
+    }
+#elif defined(LOOPER_NEON)
+    for (; i + 4 <= n; i += 4) {
+        const auto old = vld1q_f32(read + i);
+        const auto input = vld1q_f32(io + i);
+        vst1q_f32(write + i, vmlaq_f32(vld1q_f32(write + i), vld1q_f32(gains + i), input));
+        vst1q_f32(io + i, vaddq_f32(input, old));
+    }
+#endif
+
+    for (; i < n; ++i) {
+        const auto old = read[i];
+        write[i] += gains[i] * io[i];
+        io[i] += old;
+    }
+}
+
+void playFrames(const float* loop, float* out, unsigned int n) noexcept
+{
+    unsigned int i = 0;
+
+#if defined(LOOPER_SSE)
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_loadu_ps(loop + i)));
+#elif defined(LOOPER_NEON)
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vld1q_f32(loop + i)));
+#endif
+
+    for (; i < n; ++i)
+        out[i] += loop[i];
+}
+
+} // namespace looper
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace looper {
+
+// Inner loops of the looper over runs of contiguous frames (within one chunk of the loop),
+// SSE or NEON where available. Gains are per frame, ones for everything but fades.
+
+// loop = gain * in
+void recordFrames(float* loop, const float* in, const float* gains, unsigned int n) noexcept;
+
+// write += gain * io, then io += read (read before the write). write may trail read in the same
+// buffer, every location is read before it is written.
+void overdubFrames(const float* read, float* write, float* io, const float* gains, unsigned int n) noexcept;
+
+// out += loop
+void playFrames(const float* loop, float* out, unsigned int n) noexcept;
+
+} // namespace looper
@@ -0,0 +1,76 @@
+#include "loop_resampler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "fx/resampler.h"
+
+using namespace looper;
+
+static constexpr unsigned int CANCEL_CHECK_FRAMES = 4096;
+
+LoopResampler::~LoopResampler()
+{
+    cancel();
+    wait();
+}
+
+void LoopResampler::start(LoopBuffer source, unsigned int sourceFrames, LoopBuffer* target, unsigned int targetFrames,
+                          WaveformOverview* overview)
+{
+    wait();
+
+    source_ = std::move(source);
+    sourceFrames_ = sourceFrames;
+    target_ = target;
+    targetFrames_ = targetFrames;
+    overview_ = overview;
+
+    canceled_.store(false, std::memory_order_relaxed);
+    finished_.store(false, std::memory_order_relaxed);
+    worker_ = std::thread([this] { run(); });
+}
+
+void LoopResampler::wait()
+{
+    if (worker_.joinable())
+        worker_.join();
+}
+
+bool LoopResampler::isFinished() const noexcept
+{
+    return finished_.load(std::memory_order_acquire);
+}
+
+void LoopResampler::cancel() noexcept
+{
+    canceled_.store(true, std::memory_order_relaxed);
+}
+
+void LoopResampler::run() noexcept
+{
+    // ratio from the frame counts, so the loop comes out exactly targetFrames long
+    fx::Resampler resampler;
+    resampler.prepare(1, static_cast<double>(targetFrames_) / sourceFrames_, fx::Resampler::Quality::HIGH);
+
+    // the kernel wants each channel contiguous, the loop is in chunks
+    std::vector<std::vector<float>> source(source_.getNumChannels(), std::vector<float>(sourceFrames_));
+    for (auto ch{0u}; ch < source_.getNumChannels(); ++ch)
+        source_.read(ch, 0, sourceFrames_, source[ch].data());
+
+    std::vector<float> converted(CANCEL_CHECK_FRAMES);
+    for (auto block{0u}; block < targetFrames_ && !canceled_.load(std::memory_order_relaxed); block += CANCEL_CHECK_FRAMES) {
+        const auto count = std::min(CANCEL_CHECK_FRAMES, targetFrames_ - block);
+        for (auto ch{0u}; ch < source_.getNumChannels(); ++ch) {
+            resampler.convert(source[ch].data(), sourceFrames_, converted.data(), block, count, true);
+            target_->write(ch, block, count, converted.data());
+        }
+    }
+
+    if (!canceled_.load(std::memory_order_relaxed))
+        overview_->update(*target_, 0, targetFrames_);
+
+    // the old buffers go away here rather than on the control thread's next reconfiguration
+    source_.release();
+    finished_.store(true, std::memory_order_release);
+}
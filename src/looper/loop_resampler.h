@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "loop_buffer.h"
+#include "waveform_overview.h"
+
+namespace looper {
+
+// Converts a recorded loop to another sample rate on a worker thread, so a stream reopened at
+// the new rate can start right away and the loop joins in once it is ready. The loop is treated
+// as circular, the interpolation wraps around the seam instead of running into silence.
+//
+// The worker owns target and overview until isFinished() reports true.
+class LoopResampler
+{
+public:
+    LoopResampler() = default;
+    ~LoopResampler();
+
+    LoopResampler(const LoopResampler&) = delete;
+    LoopResampler& operator=(const LoopResampler&) = delete;
+
+    // Not real-time safe. Writes the sourceFrames long loop in source, stretched to
+    // targetFrames, into the start of every target channel and summarizes it into overview.
+    void start(LoopBuffer source, unsigned int sourceFrames, LoopBuffer* target, unsigned int targetFrames,
+               WaveformOverview* overview);
+
+    // Not real-time safe, joins the worker
+    void wait();
+
+    // -- Audio thread --
+    bool isFinished() const noexcept;
+    // The worker stops early, target is left partially written
+    void cancel() noexcept;
+
+private:
+    void run() noexcept;
+
+    std::thread worker_;
+    std::atomic<bool> finished_{true};
+    std::atomic<bool> canceled_{false};
+
+    LoopBuffer source_;
+    unsigned int sourceFrames_{0};
+    LoopBuffer* target_{nullptr};
+    unsigned int targetFrames_{0};
+    WaveformOverview* overview_{nullptr};
+};
+
+} // namespace looper
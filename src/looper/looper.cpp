@@ -1,19 +1,53 @@
 #include "looper.h"
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <numbers>
 
+#include "loop_kernels.h"
 #include "../audio/audio_engine.h"
+#include "../memory/page_memory.h"
 
 using namespace looper;
 
-void Looper::process(float *const *data, unsigned int nFrames) noexcept
+static void printBufferInfo(const LoopBuffer& buffers)
 {
-    consumeCommands();
+    if (buffers.empty()) {
+        std::cerr << "Failed to allocate the loop buffer" << std::endl;
+        return;
+    }
 
-    if (!data || buffers_.empty()) return;
+    std::cout << "Loop buffer: " << buffers.getSizeInBytes() / (1024 * 1024) << " MiB"
+              << (buffers.usesHugePages() ? ", huge pages" : "")
+              << (buffers.isLocked() ? ", locked" : ", not locked")
+              << ", " << buffers.getPrefaultCount() << " page faults taken up front" << std::endl;
+}
+
+void Looper::process(float *const *data, unsigned int nFrames, Timestamp bufferTime) noexcept
+{
+    if (!data || buffers_.empty()) {
+        consumeCommands();
+        return;
+    }
+
+    history_.service(buffers_);
+    history_.applyWaiting(buffers_, [this](unsigned int slot) { markOverviewDirty(slot); });
+    scheduleCommands(nFrames, bufferTime);
+
+    // split the buffer at every command so it takes effect on its own frame
+    unsigned int done = 0;
+    for (auto i{0u}; i < numScheduled_; ++i) {
+        const auto& scheduled = scheduled_[i];
+        if (scheduled.frame > done) {
+            processSegment(data, done, scheduled.frame - done);
+            done = scheduled.frame;
+        }
+        scheduled.command.apply(*this);
+    }
 
-    processInternal(data, nFrames);
+    if (done < nFrames)
+        processSegment(data, done, nFrames - done);
 }
 
 void Looper::onStart()
@@ -24,10 +58,28 @@ void Looper::onStart()
 
     numChannels_ = nChannels;
     maxFrames_ = mFrames;
+    sampleRate_ = engine.getSampleRate();
+    segment_.resize(numChannels_);
+    prepareFades();
+
+    // the frames a buffer at the top speed reads, plus what the kernels read around them
+    const auto maxSpan = static_cast<unsigned int>(std::ceil(audio::AudioEngine::MAX_FRAMES_IN_BUFFER * MAX_SPEED));
+    varispeedSource_.assign(maxSpan + 2 * INTERPOLATION_MARGIN + 2, 0.0f);
+
+    const auto bpm = bpm_.load(std::memory_order_relaxed);
+    tempo_.reset(sampleRate_);
+    tempo_.setHostTempo(bpm);
+    frameTime_ = 0;
+    loopTicks_ = 0.0;
 
-    buffers_.resize(numChannels_);
-    for (auto& b : buffers_)
-        b.resize(maxFrames_);
+    // waits for the workers to let go of the buffers before they are reallocated
+    resampler_.cancel();
+    resampler_.wait();
+    resampling_ = false;
+    stretcher_.prepare(&buffers_, numChannels_, sampleRate_, engine.getBufferSize());
+    stretchState_ = StretchState::OFF;
+
+    allocateBuffers();
 
     clear();
 
@@ -40,6 +92,116 @@ void Looper::onStop()
     clear();
 }
 
+void Looper::onSuspend()
+{
+    punchOut();
+    stopStretch();
+}
+
+void Looper::onResume()
+{
+    const auto& engine = audio::AudioEngine::getInstance();
+    if (buffers_.empty() || engine.getNumOutputChannels() != numChannels_) {
+        onStart();
+        return;
+    }
+
+    // a conversion the previous stream did not pick up any more
+    resampler_.wait();
+    if (resampling_)
+        attachResampled();
+
+    const auto sampleRate = engine.getSampleRate();
+    stretcher_.prepare(&buffers_, numChannels_, sampleRate, engine.getBufferSize());
+    stretchState_ = StretchState::OFF;
+
+    // only the buffer size changed, the loop, tempo and clock lock carry on as they are
+    if (sampleRate == sampleRate_) {
+        prepareFades();
+        return;
+    }
+
+    const auto ratio = static_cast<double>(sampleRate) / sampleRate_;
+    const auto length = numFrames_.load(std::memory_order_relaxed);
+
+    sampleRate_ = sampleRate;
+    maxFrames_ = sampleRate * MAX_LOOP_LENGTH_IN_SECONDS;
+    prepareFades();
+
+    // the clock locks again at the new rate, correctPhase() re-anchors the loop once it has
+    tempo_.reset(sampleRate_);
+    tempo_.setHostTempo(bpm_.load(std::memory_order_relaxed));
+
+    // the undo history does not survive the conversion, its chunks belong to the old block
+    history_.reset();
+    auto source = std::move(buffers_);
+    allocateBuffers();
+
+    if (state_ == State::CLEARED || length == 0 || buffers_.empty()) {
+        position_.store(0, std::memory_order_relaxed);
+        return;
+    }
+
+    const auto newLength = std::clamp(static_cast<unsigned int>(std::lround(length * ratio)), 1u, maxFrames_);
+    const auto position = static_cast<unsigned int>(std::lround(position_.load(std::memory_order_relaxed) * ratio));
+    position_.store(position % newLength, std::memory_order_relaxed);
+    numFrames_.store(newLength, std::memory_order_relaxed);
+
+    detachedFrames_ = 0;
+    resampling_ = true;
+    resampler_.start(std::move(source), length, &buffers_, newLength, &overview_);
+}
+
+void Looper::setFadeTime(double seconds)
+{
+    fadeSeconds_ = std::max(0.0, seconds);
+}
+
+void Looper::setBeatsPerBar(unsigned int beats)
+{
+    beatsPerBar_ = std::max(1u, beats);
+}
+
+void Looper::prepareFades()
+{
+    fadeFrames_ = static_cast<unsigned int>(std::lround(fadeSeconds_ * sampleRate_));
+
+    // raised cosine, a fade in and the same table read backwards sum to one at every frame
+    fadeIn_.resize(fadeFrames_);
+    for (auto i{0u}; i < fadeFrames_; ++i) {
+        const auto s = std::sin(0.5 * std::numbers::pi * (i + 0.5) / fadeFrames_);
+        fadeIn_[i] = static_cast<float>(s * s);
+    }
+
+    unityGain_.assign(audio::AudioEngine::MAX_FRAMES_IN_BUFFER, 1.0f);
+    writeGains_.assign(audio::AudioEngine::MAX_FRAMES_IN_BUFFER, 1.0f);
+    punchInDone_ = fadeFrames_;
+    punchOutRemaining_ = 0;
+    punchingOut_ = false;
+}
+
+void Looper::allocateBuffers()
+{
+    // the compressor may still be writing spare chunks of the old block
+    history_.reset();
+
+    // spare chunks for the decoded undo layers on top of the loop, the older ones are compressed
+    const auto loopChunks = (maxFrames_ + LoopBuffer::CHUNK_MASK) >> LoopBuffer::CHUNK_SHIFT;
+    buffers_.allocate(numChannels_, maxFrames_, LayerHistory::SPARE_LAYERS * loopChunks * numChannels_);
+    printBufferInfo(buffers_);
+    overview_.prepare(maxFrames_);
+
+    // two callbacks of the largest size, a stretch session winds down within one hop
+    held_.assign(numChannels_, std::vector<float>(2 * audio::AudioEngine::MAX_FRAMES_IN_BUFFER));
+    heldFrames_ = 0;
+
+    const auto compressedBudget = std::size_t{sampleRate_} * UNDO_HISTORY_SECONDS * numChannels_ * sizeof(float);
+    history_.prepare(buffers_.getNumSlots(), compressedBudget);
+    overviewDirty_.assign(buffers_.getNumChunks(), false);
+    numOverviewDirty_ = 0;
+    overviewCursor_ = 0;
+}
+
 unsigned int Looper::getCurrentPosition() const noexcept
 {
     return position_.load(std::memory_order_relaxed);
@@ -55,23 +217,62 @@ bool Looper::isEmpty() const noexcept
     return getCurrentNumFrames() == 0;
 }
 
+const WaveformOverview& Looper::getOverview() const noexcept
+{
+    return overview_;
+}
+
+void Looper::reportEvents()
+{
+    if (recordRefused_.exchange(false, std::memory_order_relaxed))
+        std::cout << "Recording refused, the loop is still being converted to the new sample rate" << std::endl;
+
+    if (const auto faults = firstPassFaults_.exchange(-1, std::memory_order_relaxed); faults >= 0)
+        std::cout << "First pass: " << faults << " page faults on the audio thread" << std::endl;
+}
+
 LooperMailbox& Looper::getCommandMailbox() noexcept
 {
     return commandMailbox_;
 }
 
+LooperMailbox& Looper::getMidiMailbox() noexcept
+{
+    return midiMailbox_;
+}
+
 void Looper::startRecording() noexcept
 {
+    // the worker owns the buffers until the conversion is attached, nothing would be recorded
+    if (resampling_) {
+        recordRefused_.store(true, std::memory_order_relaxed);
+        return;
+    }
+
     switch (state_) {
         case State::CLEARED: {
             position_.store(0, std::memory_order_relaxed);
+            recordStartFrame_ = frameTime_;
+            firstPassFaultsStart_ = memory::threadMinorFaultCount();
+            punchInDone_ = 0;
             state_ = State::RECORDING;
             break;
         }
         case State::RECORDING: {
+            // back in during the punch-out fade, the same pass fades up again from where it is
+            if (punchingOut_) {
+                punchInDone_ = punchOutRemaining_;
+                punchOutRemaining_ = 0;
+                punchingOut_ = false;
+            }
             break;
         }
         case State::PLAYBACK: {
+            // the loop plays at another tempo or speed than it was recorded at, an overdub
+            // would not line up
+            if (stretchState_ != StretchState::OFF || isVarispeed()) break;
+            history_.beginLayer(buffers_);
+            punchInDone_ = 0;
             state_ = State::RECORDING;
             break;
         }
@@ -79,16 +280,34 @@ void Looper::startRecording() noexcept
 }
 
 void Looper::stopRecording() noexcept
+{
+    // Recording carries on through the fade out. For the first pass that is the audio after
+    // the loop end, it is crossfaded with the faded in loop start.
+    if (state_ == State::RECORDING && fadeFrames_ > 0) {
+        if (!punchingOut_) {
+            punchingOut_ = true;
+            punchOutRemaining_ = fadeFrames_;
+            if (isEmpty())
+                firstPassStop_ = position_.load(std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    punchOut();
+}
+
+void Looper::punchOut() noexcept
 {
     switch (state_) {
         case State::CLEARED: {
             break;
         }
         case State::RECORDING: {
-            if (isEmpty()) {
-                numFrames_.store(position_.load(std::memory_order_relaxed), std::memory_order_relaxed);
-                position_.store(0, std::memory_order_relaxed);
-            }
+            if (isEmpty())
+                finishFirstPass();
+            history_.endLayer();
+            punchOutRemaining_ = 0;
+            punchingOut_ = false;
             state_ = State::PLAYBACK;
             break;
         }
@@ -102,51 +321,674 @@ void Looper::clear() noexcept
 {
     if (state_ == State::CLEARED) return;
 
-    stopRecording();
+    punchOut();
+    stopStretch();
+    if (resampling_)
+        resampler_.cancel();
+
+    // Nothing is erased, the next first pass writes over the old loop instead of adding to it.
+    // The resample worker writes the overview until it finishes, attaching clears it then.
+    if (!resampling_)
+        overview_.clear();
 
-    const auto toErase = numFrames_.load(std::memory_order_relaxed);
-    for (auto& b : buffers_)
-        std::ranges::fill_n(b.begin(), toErase, 0.0f);
+    history_.clear(buffers_);
+    heldFrames_ = 0;
+    std::fill(overviewDirty_.begin(), overviewDirty_.end(), false);
+    numOverviewDirty_ = 0;
 
     state_ = State::CLEARED;
     position_.store(0, std::memory_order_relaxed);
     numFrames_.store(0, std::memory_order_relaxed);
 }
 
+void Looper::undo() noexcept
+{
+    // the history went with the old block while a conversion is running
+    if (state_ == State::CLEARED || resampling_) return;
+
+    punchOut();
+    history_.undo(buffers_, [this](unsigned int slot) { markOverviewDirty(slot); });
+}
+
+void Looper::redo() noexcept
+{
+    if (state_ == State::CLEARED || resampling_) return;
+
+    punchOut();
+    history_.redo(buffers_, [this](unsigned int slot) { markOverviewDirty(slot); });
+}
+
+void Looper::markOverviewDirty(unsigned int slot) noexcept
+{
+    const auto chunk = slot % buffers_.getNumChunks();
+    if (overviewDirty_[chunk]) return;
+    overviewDirty_[chunk] = true;
+    ++numOverviewDirty_;
+}
+
+void Looper::refreshOverview() noexcept
+{
+    const auto numChunks = buffers_.getNumChunks();
+    for (auto n{0u}; n < OVERVIEW_CHUNKS_PER_BLOCK && numOverviewDirty_ > 0; ++n) {
+        while (!overviewDirty_[overviewCursor_])
+            overviewCursor_ = (overviewCursor_ + 1) % numChunks;
+
+        overviewDirty_[overviewCursor_] = false;
+        --numOverviewDirty_;
+        overview_.update(buffers_, overviewCursor_ << LoopBuffer::CHUNK_SHIFT, LoopBuffer::CHUNK_FRAMES);
+    }
+}
+
+void Looper::attachResampled() noexcept
+{
+    resampling_ = false;
+
+    if (state_ == State::CLEARED) {
+        overview_.clear();
+        detachedFrames_ = 0;
+        return;
+    }
+
+    // the loop kept running silently while it was converted
+    if (const auto length = numFrames_.load(std::memory_order_relaxed); length > 0 && state_ != State::CLEARED) {
+        const auto position = position_.load(std::memory_order_relaxed);
+        position_.store(static_cast<unsigned int>((static_cast<std::uint64_t>(position) + detachedFrames_) % length),
+                        std::memory_order_relaxed);
+    }
+    detachedFrames_ = 0;
+}
+
+void Looper::finishFirstPass() noexcept
+{
+    // stopped while the first frames were still held back, the stretcher is gone by now or
+    // about to be
+    if (heldFrames_ > 0) {
+        stretcher_.waitIdle();
+        flushHeld();
+    }
+
+    // the punch-out fade was recorded past where stop was pressed, unless it was cut short
+    const auto recorded = position_.load(std::memory_order_relaxed);
+    const auto stopped = punchingOut_ ? std::min(firstPassStop_, recorded) : recorded;
+    const auto fadeRecorded = punchingOut_ && punchOutRemaining_ == 0;
+    auto length = stopped;
+    auto bars = 0u;
+
+    const auto framesPerBar = tempo_.getFramesPerBeat() * beatsPerBar_;
+    if (tempo_.hasTempo() && stopped > 0 && framesPerBar > 0.0) {
+        bars = std::max(1u, static_cast<unsigned int>(std::lround(stopped / framesPerBar)));
+        while (bars > 1 && bars * framesPerBar > maxFrames_)
+            --bars;
+        length = std::min(maxFrames_, static_cast<unsigned int>(std::lround(bars * framesPerBar)));
+    }
+
+    // What was recorded past the loop end is folded onto the loop start, which was faded in
+    // while recording. Stopped on time, that is just the punch-out fade and the seam is a
+    // crossfade of the loop start with the audio that followed its end. Stopped late, the
+    // overshoot carries on across the seam over the faded in start. Stopped early, the seam
+    // dips through silence until the bar is complete.
+    const auto recordingEnd = length < recorded ? std::min(recorded, 2 * length) : recorded;
+    if (!fadeRecorded || recordingEnd < recorded)
+        fadeOut(recordingEnd, std::min(fadeFrames_, recordingEnd));
+
+    if (length < recorded) {
+        // stopped late: the overshoot is the start of the next cycle, fold it onto the loop start
+        const auto overshoot = std::min(recorded - length, length);
+        for (auto ch{0u}; ch < numChannels_; ++ch) {
+            for (auto i{0u}; i < overshoot; ++i) {
+                buffers_.at(ch, i) += buffers_.at(ch, length + i);
+                buffers_.at(ch, length + i) = 0.0f;
+            }
+        }
+        buffers_.zero(length + overshoot, recorded - length - overshoot);
+        overview_.update(buffers_, 0, overshoot);
+        overview_.update(buffers_, length, recorded - length);
+        position_.store(overshoot % length, std::memory_order_relaxed);
+    } else if (length == recorded) {
+        position_.store(0, std::memory_order_relaxed);
+    }
+    // stopped early: keep playing silence until the bar is complete
+
+    // The first pass wrote over whatever an earlier loop left behind. Silence the rest of the
+    // bar, and of the last overview bin so the waveform does not show the old loop's tail.
+    const auto binEnd = (length + WaveformOverview::BASE_BIN_FRAMES - 1) / WaveformOverview::BASE_BIN_FRAMES
+        * WaveformOverview::BASE_BIN_FRAMES;
+    if (const auto end = std::min(maxFrames_, binEnd); end > recorded) {
+        buffers_.zero(recorded, end - recorded);
+        overview_.update(buffers_, recorded, end - recorded);
+    }
+
+    numFrames_.store(length, std::memory_order_relaxed);
+    loopBpm_ = tempo_.hasTempo() ? tempo_.getBpm() : 0.0;
+
+    if (bars > 0 && tempo_.isClockLocked()) {
+        loopTicks_ = static_cast<double>(bars * beatsPerBar_ * TempoSync::TICKS_PER_BEAT);
+        anchorTick_ = tempo_.getTickPosition(recordStartFrame_);
+    } else {
+        loopTicks_ = 0.0;
+    }
+
+    firstPassFaults_.store(memory::threadMinorFaultCount() - firstPassFaultsStart_, std::memory_order_relaxed);
+}
+
+void Looper::flushHeld() noexcept
+{
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        for (auto i{0u}; i < heldFrames_; ++i)
+            buffers_.at(ch, heldStart_ + i) = held_[ch][i];
+    }
+
+    overview_.update(buffers_, heldStart_, heldFrames_);
+    heldFrames_ = 0;
+}
+
+void Looper::fadeOut(unsigned int end, unsigned int count) noexcept
+{
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        for (auto i{0u}; i < count; ++i)
+            buffers_.at(ch, end - count + i) *= fadeIn_[count - 1 - i];
+    }
+}
+
+void Looper::clockTick() noexcept
+{
+    tempo_.tick(frameTime_);
+    bpm_.store(tempo_.getBpm(), std::memory_order_relaxed);
+
+    // a stretched loop is held to the clock through its speed, a varispeed one does not follow it
+    if (loopTicks_ > 0.0 && state_ != State::CLEARED && tempo_.isClockLocked()) {
+        if (stretchState_ == StretchState::OFF && !isVarispeed())
+            correctPhase();
+        else if (stretchState_ == StretchState::ON)
+            correctStretchPhase();
+    }
+}
+
+void Looper::clockStart() noexcept
+{
+    tempo_.clockStart();
+
+    // the song restarts, so does the loop
+    if (loopTicks_ > 0.0 && state_ != State::CLEARED) {
+        stopStretch();
+        position_.store(0, std::memory_order_relaxed);
+        anchorTick_ = 0.0;
+    }
+}
+
+void Looper::clockStop() noexcept
+{
+    tempo_.clockStop();
+}
+
+void Looper::setTempo(double bpm) noexcept
+{
+    tempo_.setHostTempo(bpm);
+    bpm_.store(tempo_.getBpm(), std::memory_order_relaxed);
+}
+
+double Looper::getTempo() const noexcept
+{
+    return bpm_.load(std::memory_order_relaxed);
+}
+
+double Looper::getPhaseError(double position) const noexcept
+{
+    const auto loopLength = static_cast<double>(numFrames_.load(std::memory_order_relaxed));
+    const auto ticks = tempo_.getTickPosition(frameTime_) - anchorTick_;
+    auto expected = std::fmod(ticks, loopTicks_) / loopTicks_ * loopLength;
+    if (expected < 0.0) expected += loopLength;
+
+    auto error = position - expected;
+    if (error > loopLength / 2) error -= loopLength;
+    if (error < -loopLength / 2) error += loopLength;
+    return error;
+}
+
+void Looper::reanchor(double position) noexcept
+{
+    const auto loopLength = static_cast<double>(numFrames_.load(std::memory_order_relaxed));
+    anchorTick_ = tempo_.getTickPosition(frameTime_) - position / loopLength * loopTicks_;
+}
+
+void Looper::correctPhase() noexcept
+{
+    const auto length = numFrames_.load(std::memory_order_relaxed);
+    if (length == 0) return;
+
+    const auto pos = position_.load(std::memory_order_relaxed);
+    const auto error = getPhaseError(static_cast<double>(pos));
+
+    // far off means the clock jumped, follow it instead of slewing
+    if (std::abs(error) > tempo_.getFramesPerBeat() / 2) {
+        reanchor(static_cast<double>(pos));
+        return;
+    }
+
+    // slew by at most one frame per tick, inaudible and enough for any real clock drift
+    if (std::abs(error) >= 1.0) {
+        const auto step = error > 0.0 ? length - 1 : 1u;
+        position_.store((pos + step) % length, std::memory_order_relaxed);
+    }
+}
+
+void Looper::correctStretchPhase() noexcept
+{
+    const auto length = numFrames_.load(std::memory_order_relaxed);
+    if (length == 0) return;
+
+    // the stretcher reads a beat of the loop per clock beat, whatever the tempo
+    const auto position = stretcher_.getSourcePosition();
+    const auto error = getPhaseError(position);
+    const auto beatFrames = length / (loopTicks_ / TempoSync::TICKS_PER_BEAT);
+
+    if (std::abs(error) > beatFrames / 2) {
+        reanchor(position);
+        stretchCorrection_ = 1.0;
+        return;
+    }
+
+    // reads that much less or more over the next beat, tempo nudges too small to hear
+    stretchCorrection_ = std::clamp(1.0 - error / beatFrames, 1.0 - MAX_STRETCH_CORRECTION, 1.0 + MAX_STRETCH_CORRECTION);
+}
+
+void Looper::setLatencyCompensation(unsigned int frames) noexcept
+{
+    latencyFrames_ = frames;
+}
+
 void Looper::consumeCommands() noexcept
 {
-    commandMailbox_.consumeAll([&](const LooperCommand& cmd) {
+    const auto apply = [&](const LooperCommand& cmd) {
         cmd.apply(*this);
-    });
+    };
+
+    commandMailbox_.consumeAll(apply);
+    midiMailbox_.consumeAll(apply);
+}
+
+void Looper::scheduleCommands(unsigned int nFrames, Timestamp bufferTime) noexcept
+{
+    numScheduled_ = 0;
+
+    const auto schedule = [&](const LooperCommand& cmd) {
+        unsigned int frame = 0;
+        if (bufferTime != 0 && cmd.getTimestamp() != 0 && nFrames > 0) {
+            const auto age = static_cast<double>(bufferTime - cmd.getTimestamp()) * 1e-9;
+            const auto ageFrames = static_cast<long long>(age * sampleRate_);
+            const auto lastFrame = static_cast<long long>(nFrames) - 1;
+            frame = static_cast<unsigned int>(std::clamp(lastFrame + 1 - ageFrames, 0LL, lastFrame));
+        }
+
+        if (numScheduled_ == scheduled_.size()) {
+            cmd.apply(*this);
+            return;
+        }
+
+        // insertion sort keeps commands with the same frame in arrival order
+        auto i = numScheduled_++;
+        while (i > 0 && scheduled_[i - 1].frame > frame) {
+            scheduled_[i] = scheduled_[i - 1];
+            --i;
+        }
+        scheduled_[i] = ScheduledCommand{frame, cmd};
+    };
+
+    commandMailbox_.consumeAll(schedule);
+    midiMailbox_.consumeAll(schedule);
+}
+
+void Looper::processSegment(float *const *data, unsigned int offset, unsigned int nFrames) noexcept
+{
+    for (auto ch{0u}; ch < numChannels_; ++ch)
+        segment_[ch] = data[ch] + offset;
+
+    processInternal(segment_.data(), nFrames);
+    frameTime_ += nFrames;
 }
 
 void Looper::processInternal(float *const *data, unsigned int nFrames) noexcept
 {
+    if (resampling_) {
+        if (!resampler_.isFinished()) {
+            detachedFrames_ += nFrames;
+            return;
+        }
+        attachResampled();
+    }
+
     if (state_ == State::CLEARED) return;
 
+    if (numOverviewDirty_ > 0)
+        refreshOverview();
+
+    // varispeed takes over from a stretch, its playhead carries on from where the stretch was
+    if (state_ == State::PLAYBACK && isVarispeed()) {
+        if (stretchState_ != StretchState::OFF)
+            stopStretch();
+        processVarispeed(data, nFrames);
+        return;
+    }
+
+    if (state_ == State::PLAYBACK && (stretchState_ != StretchState::OFF || std::abs(getStretchSpeed() - 1.0) > STRETCH_THRESHOLD)) {
+        processStretched(data, nFrames);
+        return;
+    }
+
     const auto currentNumFrames = numFrames_.load(std::memory_order_relaxed);
     const auto wrapAround = currentNumFrames > 0 ? currentNumFrames : maxFrames_;
+
     unsigned int pos = position_.load(std::memory_order_relaxed);
 
-    for (auto i{0u}; i < nFrames; ++i) {
-        for (auto ch{0u}; ch < numChannels_; ++ch) {
-            if (state_ == State::RECORDING) {
-                const float oldSample = buffers_[ch][pos];
-                buffers_[ch][pos] += data[ch][i];
-                data[ch][i] += oldSample;
-            } else if (state_ == State::PLAYBACK) {
-                data[ch][i] += buffers_[ch][pos];
-            }
-        }
+    // The first pass overwrites the cleared loop, a stretch session winding down may still be
+    // reading it (usually gone by the next buffer). Until it is, the pass records into held_.
+    auto firstPass = state_ == State::RECORDING && currentNumFrames == 0;
+    auto hold = firstPass && !stretcher_.isIdle();
+    if (hold && (heldFrames_ + nFrames > held_.front().size() || pos + nFrames >= wrapAround)) {
+        // out of room, the worker only has the hop it is in left to finish
+        stretcher_.waitIdle();
+        hold = false;
+    }
+    if (firstPass && !hold && heldFrames_ > 0)
+        flushHeld();
+    if (hold && heldFrames_ == 0)
+        heldStart_ = pos;
+
+    // the first pass defines the loop, only overdubs are aligned to what was heard
+    const auto offset = currentNumFrames > 0 ? latencyFrames_ % currentNumFrames : 0u;
+    unsigned int writePos = pos >= offset ? pos - offset : pos + wrapAround - offset;
+    const auto writeStart = writePos;
+    const auto firstPart = std::min(nFrames, wrapAround - writeStart);
+
+    if (state_ == State::RECORDING && !firstPass) {
+        history_.prepareWrite(buffers_, writeStart, firstPart);
+        history_.prepareWrite(buffers_, 0, nFrames - firstPart);
+    }
+
+    const auto* gains = state_ == State::RECORDING ? getWriteGains(nFrames) : unityGain_.data();
+
+    for (auto done{0u}; done < nFrames;) {
+        // the first pass ends at the maximum length, recording on past it overdubs
+        const auto access = hold ? Access::HOLD : firstPass ? Access::RECORD
+                           : state_ == State::RECORDING ? Access::OVERDUB : Access::PLAY;
+        const auto count = firstPass ? std::min(nFrames - done, wrapAround - pos) : nFrames - done;
+
+        for (auto ch{0u}; ch < numChannels_; ++ch)
+            processChannel(ch, data[ch] + done, gains + done, count, pos, writePos, wrapAround, access);
+
+        done += count;
+        pos = static_cast<unsigned int>((static_cast<std::uint64_t>(pos) + count) % wrapAround);
+        writePos = static_cast<unsigned int>((static_cast<std::uint64_t>(writePos) + count) % wrapAround);
 
-        pos++;
-        if (pos >= wrapAround) {
-            pos = 0;
+        if (firstPass && pos == 0) {
             numFrames_.store(wrapAround, std::memory_order_relaxed);
+            firstPass = false;
+            history_.beginLayer(buffers_);
+            history_.prepareWrite(buffers_, 0, nFrames - done);
         }
     }
 
+    // before the punch-out, finishing a first pass moves the playhead
     position_.store(pos, std::memory_order_relaxed);
+    if (hold)
+        heldFrames_ += nFrames;
+
+    if (state_ == State::RECORDING) {
+        if (!hold) {
+            overview_.update(buffers_, writeStart, firstPart);
+            overview_.update(buffers_, 0, nFrames - firstPart);
+        }
+
+        // the punch-out fade is written, the pass is over
+        if (punchingOut_ && punchOutRemaining_ == 0)
+            punchOut();
+    }
+}
+
+const float* Looper::getWriteGains(unsigned int nFrames) noexcept
+{
+    if (punchInDone_ >= fadeFrames_ && !punchingOut_)
+        return unityGain_.data();
+
+    std::fill_n(writeGains_.begin(), nFrames, 1.0f);
+
+    const auto fadeIn = std::min(nFrames, fadeFrames_ - std::min(punchInDone_, fadeFrames_));
+    std::copy_n(fadeIn_.begin() + punchInDone_, fadeIn, writeGains_.begin());
+    punchInDone_ += fadeIn;
+
+    // nothing is written after the fade out, the pass ends with this buffer
+    if (punchingOut_) {
+        const auto fadeOut = std::min(nFrames, punchOutRemaining_);
+        for (auto i{0u}; i < fadeOut; ++i)
+            writeGains_[i] *= fadeIn_[punchOutRemaining_ - 1 - i];
+        std::fill(writeGains_.begin() + fadeOut, writeGains_.begin() + nFrames, 0.0f);
+        punchOutRemaining_ -= fadeOut;
+    }
+
+    return writeGains_.data();
+}
+
+void Looper::processChannel(unsigned int channel, float* io, const float* gains, unsigned int nFrames,
+                            unsigned int pos, unsigned int writePos, unsigned int wrapAround, Access access) noexcept
+{
+    // runs end wherever the read or the write position reaches a chunk boundary or the seam
+    for (auto done{0u}; done < nFrames;) {
+        const auto run = std::min({nFrames - done, wrapAround - pos, wrapAround - writePos,
+                                   LoopBuffer::CHUNK_FRAMES - (pos & LoopBuffer::CHUNK_MASK),
+                                   LoopBuffer::CHUNK_FRAMES - (writePos & LoopBuffer::CHUNK_MASK)});
+
+        switch (access) {
+            case Access::RECORD: recordFrames(&buffers_.at(channel, writePos), io + done, gains + done, run); break;
+            case Access::HOLD: recordFrames(held_[channel].data() + (writePos - heldStart_), io + done, gains + done, run); break;
+            case Access::OVERDUB: overdubFrames(&buffers_.at(channel, pos), &buffers_.at(channel, writePos), io + done, gains + done, run); break;
+            case Access::PLAY: playFrames(&buffers_.at(channel, pos), io + done, run); break;
+        }
+
+        done += run;
+        pos += run;
+        if (pos >= wrapAround) pos = 0;
+        writePos += run;
+        if (writePos >= wrapAround) writePos = 0;
+    }
+}
+
+void Looper::processStretched(float *const *data, unsigned int nFrames) noexcept
+{
+    const auto length = numFrames_.load(std::memory_order_relaxed);
+    const auto speed = getStretchSpeed();
+    const auto stretch = std::abs(speed - 1.0) > STRETCH_THRESHOLD;
+    const auto fade = static_cast<float>(STRETCH_FADE_FRAMES);
+
+    if (stretch)
+        stretcher_.setSpeed(speed * stretchCorrection_);
+
+    unsigned int done = 0;
+    while (done < nFrames) {
+        const auto remaining = nFrames - done;
+
+        switch (stretchState_) {
+            case StretchState::OFF: {
+                const auto start = (position_.load(std::memory_order_relaxed) + STRETCH_PREROLL_FRAMES) % length;
+                if (stretch && stretcher_.start(start, length, speed * stretchCorrection_)) {
+                    stretchState_ = StretchState::PREROLL;
+                    stretchRemaining_ = STRETCH_PREROLL_FRAMES;
+                    break;
+                }
+
+                playDirect(data, done, remaining, 1.0f, 1.0f);
+                done = nFrames;
+                break;
+            }
+            case StretchState::PREROLL: {
+                const auto n = std::min(remaining, stretchRemaining_);
+                playDirect(data, done, n, 1.0f, 1.0f);
+                done += n;
+                stretchRemaining_ -= n;
+
+                if (stretchRemaining_ == 0) {
+                    // the direct playhead is now where the stretcher started
+                    if (stretch && stretcher_.available() >= STRETCH_FADE_FRAMES) {
+                        stretchState_ = StretchState::FADE_IN;
+                        stretchRemaining_ = STRETCH_FADE_FRAMES;
+                    } else {
+                        stopStretch();
+                    }
+                }
+                break;
+            }
+            case StretchState::FADE_IN: {
+                const auto n = std::min(remaining, stretchRemaining_);
+                const auto from = 1.0f - static_cast<float>(stretchRemaining_) / fade;
+                const auto to = 1.0f - static_cast<float>(stretchRemaining_ - n) / fade;
+                if (!stretcher_.mix(data, done, n, from, to)) {
+                    stopStretch();
+                    break;
+                }
+
+                playDirect(data, done, n, 1.0f - from, 1.0f - to);
+                done += n;
+                stretchRemaining_ -= n;
+
+                if (stretchRemaining_ == 0) {
+                    stretchState_ = StretchState::ON;
+                    position_.store(static_cast<unsigned int>(stretcher_.getSourcePosition()) % length, std::memory_order_relaxed);
+                }
+                break;
+            }
+            case StretchState::ON: {
+                // leaves while the stretcher still holds a whole fade, running dry would cut off
+                if (stretch && stretcher_.available() >= remaining + STRETCH_FADE_FRAMES) {
+                    stretcher_.mix(data, done, remaining, 1.0f, 1.0f);
+                    done = nFrames;
+                    position_.store(static_cast<unsigned int>(stretcher_.getSourcePosition()) % length, std::memory_order_relaxed);
+                    break;
+                }
+
+                // back at the recorded tempo, or the worker fell behind: crossfade to the loop
+                position_.store(static_cast<unsigned int>(stretcher_.getSourcePosition()) % length, std::memory_order_relaxed);
+                if (stretcher_.available() >= STRETCH_FADE_FRAMES) {
+                    stretchState_ = StretchState::FADE_OUT;
+                    stretchRemaining_ = STRETCH_FADE_FRAMES;
+                } else {
+                    stopStretch();
+                }
+                break;
+            }
+            case StretchState::FADE_OUT: {
+                const auto n = std::min(remaining, stretchRemaining_);
+                const auto from = static_cast<float>(stretchRemaining_) / fade;
+                const auto to = static_cast<float>(stretchRemaining_ - n) / fade;
+                stretcher_.mix(data, done, n, from, to);
+                playDirect(data, done, n, 1.0f - from, 1.0f - to);
+                done += n;
+                stretchRemaining_ -= n;
+
+                if (stretchRemaining_ == 0)
+                    stopStretch();
+                break;
+            }
+        }
+    }
+}
+
+void Looper::playDirect(float *const *data, unsigned int offset, unsigned int nFrames, float fromGain, float toGain) noexcept
+{
+    const auto length = numFrames_.load(std::memory_order_relaxed);
+    const auto pos = position_.load(std::memory_order_relaxed);
+    const auto gainStep = nFrames > 0 ? (toGain - fromGain) / static_cast<float>(nFrames) : 0.0f;
+
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        auto p = pos;
+        auto gain = fromGain;
+        for (auto i{0u}; i < nFrames; ++i) {
+            data[ch][offset + i] += gain * buffers_.at(ch, p);
+            gain += gainStep;
+            if (++p >= length) p = 0;
+        }
+    }
+
+    position_.store((pos + nFrames) % length, std::memory_order_relaxed);
+}
+
+void Looper::setSpeed(double ratio) noexcept
+{
+    if (!std::isfinite(ratio) || ratio == 0.0) return;
+    const auto speed = std::clamp(std::abs(ratio), MIN_SPEED, MAX_SPEED);
+    speed_.store(ratio < 0.0 ? -speed : speed, std::memory_order_relaxed);
+}
+
+double Looper::getSpeed() const noexcept
+{
+    return speed_.load(std::memory_order_relaxed);
+}
+
+void Looper::toggleReverse() noexcept
+{
+    speed_.store(-speed_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void Looper::setInterpolation(Interpolation mode) noexcept
+{
+    interpolation_ = mode;
+}
+
+bool Looper::isVarispeed() const noexcept
+{
+    return speed_.load(std::memory_order_relaxed) != 1.0;
+}
+
+void Looper::processVarispeed(float *const *data, unsigned int nFrames) noexcept
+{
+    const auto length = numFrames_.load(std::memory_order_relaxed);
+    if (length == 0) return;
+    const auto loopLength = static_cast<double>(length);
+    const auto step = speed_.load(std::memory_order_relaxed);
+
+    // the integer position moved (direct playback, a stretch, the clock), carry on from there
+    if (const auto pos = position_.load(std::memory_order_relaxed); static_cast<unsigned int>(playhead_) != pos)
+        playhead_ = static_cast<double>(pos);
+
+    // every frame the block reads, backwards or forwards, gathered into one contiguous run
+    const auto last = playhead_ + (nFrames - 1) * step;
+    const auto first = static_cast<long long>(std::floor(std::min(playhead_, last))) - INTERPOLATION_MARGIN + 1;
+    const auto count = static_cast<unsigned int>(std::ceil(std::abs(last - playhead_))) + 2 * INTERPOLATION_MARGIN + 1;
+    const auto position = playhead_ - static_cast<double>(first);
+
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        gatherLoop(ch, first, count, length);
+        interpolate(interpolation_, varispeedSource_.data(), position, step, data[ch], nFrames);
+    }
+
+    playhead_ = std::fmod(playhead_ + nFrames * step, loopLength);
+    if (playhead_ < 0.0) playhead_ += loopLength;
+    if (playhead_ >= loopLength) playhead_ = 0.0;
+    position_.store(static_cast<unsigned int>(playhead_), std::memory_order_relaxed);
+}
+
+void Looper::gatherLoop(unsigned int channel, long long first, unsigned int count, unsigned int length) noexcept
+{
+    // wraps around the seam, as often as it takes for a loop shorter than the run
+    auto frame = static_cast<unsigned int>((first % length + length) % length);
+    for (auto done{0u}; done < count;) {
+        const auto n = std::min(count - done, length - frame);
+        buffers_.read(channel, frame, n, varispeedSource_.data() + done);
+        done += n;
+        frame = 0;
+    }
+}
+
+double Looper::getStretchSpeed() const noexcept
+{
+    const auto bpm = bpm_.load(std::memory_order_relaxed);
+    if (loopBpm_ <= 0.0 || bpm <= 0.0) return 1.0;
+    return bpm / loopBpm_;
+}
+
+void Looper::stopStretch() noexcept
+{
+    stretcher_.stop();
+    stretchState_ = StretchState::OFF;
+    stretchCorrection_ = 1.0;
 }
 
 const char* Looper::stateToStr(State state)
@@ -1,30 +1,109 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <vector>
 
+#include "interpolation.h"
+#include "layer_history.h"
+#include "loop_buffer.h"
+#include "loop_resampler.h"
 #include "looper_commands.h"
+#include "tempo_sync.h"
+#include "time_stretch.h"
+#include "waveform_overview.h"
+#include "timestamp.h"
 
 namespace looper {
 
 class Looper
 {
 public:
-    void process(float *const *data, unsigned int nFrames) noexcept;
+    // bufferTime is the capture time of the buffer start, timestamped commands are applied
+    // at their frame offset relative to it (one buffer after they happened)
+    void process(float *const *data, unsigned int nFrames, Timestamp bufferTime = 0) noexcept;
     void onStart();
     void onStop();
 
+    // Stream reconfiguration that keeps the loop. onSuspend() punches out of a recording,
+    // onResume() takes the new buffer size and, when the sample rate changed, converts the loop
+    // in the background. It stays silent and refuses to record until the conversion is done,
+    // then plays from where it would have been. Both are called while the stream is stopped.
+    void onSuspend();
+    void onResume();
+
+    // One producer per mailbox: the control/UI thread and the MIDI thread
     LooperMailbox& getCommandMailbox() noexcept;
+    LooperMailbox& getMidiMailbox() noexcept;
     unsigned int getCurrentPosition() const noexcept;
     unsigned int getCurrentNumFrames() const noexcept;
     bool isEmpty() const noexcept;
+    const WaveformOverview& getOverview() const noexcept;
+    // Prints what the audio thread had to report since the last call: recordings refused
+    // while the loop is converted to a new sample rate, and the page faults it took while
+    // recording the last first pass (the buffers are prefaulted, anything but 0 means
+    // something else faulted). Not real-time safe, for the control thread.
+    void reportEvents();
 
+    // Refused while the loop is being converted to a new sample rate, the input would be lost
     void startRecording() noexcept;
     void stopRecording() noexcept;
     void clear() noexcept;
 
+    // Takes back the last overdub pass, or puts it back in. A pass being recorded ends first.
+    void undo() noexcept;
+    void redo() noexcept;
+
+    // With a tempo, the first pass is snapped to whole bars and, under MIDI clock, the
+    // playhead is kept phase locked to the clock. Later tempo changes time-stretch the loop,
+    // overdubs are refused while it plays at a different tempo than it was recorded at.
+    void clockTick() noexcept;
+    void clockStart() noexcept;
+    void clockStop() noexcept;
+    void setTempo(double bpm) noexcept;
+    double getTempo() const noexcept;
+
+    // Frames between a sample being played and the player's response reaching process().
+    // Overdubs are written this far behind the playhead so they line up with the loop.
+    void setLatencyCompensation(unsigned int frames) noexcept;
+
+    // Varispeed: the loop plays faster or slower (and higher or lower) by ratio, backwards when
+    // it is negative. Reads between frames are interpolated by the selected kernel. Overdubs are
+    // refused while it plays at another speed or backwards, a pass being recorded keeps going at
+    // normal speed and the new speed takes over once it ends.
+    void setSpeed(double ratio) noexcept;
+    double getSpeed() const noexcept;
+    void toggleReverse() noexcept;
+    void setInterpolation(Interpolation mode) noexcept;
+
+    // Fades at punch-in and punch-out and a crossfade where the first pass meets the loop
+    // start, 0 cuts hard. Not real-time safe, takes effect on the next onStart()/onResume().
+    void setFadeTime(double seconds);
+    // Meter the first recording is rounded to whole bars of, with a tempo. Not real-time safe,
+    // set before the stream starts.
+    void setBeatsPerBar(unsigned int beats);
+
 private:
     static constexpr unsigned int MAX_LOOP_LENGTH_IN_SECONDS = 15;
+    static constexpr unsigned int DEFAULT_BEATS_PER_BAR = 4;
+    // Memory the compressed undo layers may take, as much as this much uncompressed audio.
+    // The decoded layers next to the position come on top, LayerHistory::SPARE_LAYERS loops.
+    static constexpr unsigned int UNDO_HISTORY_SECONDS = 30;
+    // Chunks changed by undo/redo are summarized into the overview a few per buffer
+    static constexpr unsigned int OVERVIEW_CHUNKS_PER_BLOCK = 2;
+    static constexpr double DEFAULT_FADE_SECONDS = 0.005;
+    // Varispeed range, the scratch the kernels read from holds a buffer's worth at the top speed
+    static constexpr double MIN_SPEED = 0.125;
+    static constexpr double MAX_SPEED = 4.0;
+
+    // Tempo deviations below this are left to the clock phase lock
+    static constexpr double STRETCH_THRESHOLD = 0.001;
+    // Direct playback continues while the stretcher renders ahead, then crossfades to it
+    static constexpr unsigned int STRETCH_PREROLL_FRAMES = 4096;
+    static constexpr unsigned int STRETCH_FADE_FRAMES = 512;
+    static_assert(STRETCH_FADE_FRAMES <= TimeStretcher::RESERVE_FRAMES);
+    // Most a stretched loop's speed is bent to stay phase locked to the clock
+    static constexpr double MAX_STRETCH_CORRECTION = 0.02;
 
     enum class State
     {
@@ -33,19 +112,133 @@ private:
         PLAYBACK,
     };
 
+    enum class StretchState
+    {
+        OFF,
+        PREROLL,
+        FADE_IN,
+        ON,
+        FADE_OUT,
+    };
+
+    // What a buffer does with the loop, per run of frames
+    enum class Access
+    {
+        RECORD,
+        // the first pass while the loop is still read by a stretch session, goes to held_
+        HOLD,
+        OVERDUB,
+        PLAY,
+    };
+
+    struct ScheduledCommand
+    {
+        unsigned int frame{0};
+        LooperCommand command;
+    };
+
     void consumeCommands() noexcept;
+    void scheduleCommands(unsigned int nFrames, Timestamp bufferTime) noexcept;
+    void processSegment(float *const *data, unsigned int offset, unsigned int nFrames) noexcept;
     void processInternal(float *const *data, unsigned int nFrames) noexcept;
+    void processChannel(unsigned int channel, float* io, const float* gains, unsigned int nFrames,
+                        unsigned int pos, unsigned int writePos, unsigned int wrapAround, Access access) noexcept;
+    const float* getWriteGains(unsigned int nFrames) noexcept;
+    void processStretched(float *const *data, unsigned int nFrames) noexcept;
+    void playDirect(float *const *data, unsigned int offset, unsigned int nFrames, float fromGain, float toGain) noexcept;
+    bool isVarispeed() const noexcept;
+    void processVarispeed(float *const *data, unsigned int nFrames) noexcept;
+    void gatherLoop(unsigned int channel, long long first, unsigned int count, unsigned int length) noexcept;
+    double getStretchSpeed() const noexcept;
+    void stopStretch() noexcept;
+    void allocateBuffers();
+    void prepareFades();
+    void punchOut() noexcept;
+    void fadeOut(unsigned int end, unsigned int count) noexcept;
+    void finishFirstPass() noexcept;
+    void flushHeld() noexcept;
+    void markOverviewDirty(unsigned int slot) noexcept;
+    void refreshOverview() noexcept;
+    void attachResampled() noexcept;
+    double getPhaseError(double position) const noexcept;
+    void reanchor(double position) noexcept;
+    void correctPhase() noexcept;
+    void correctStretchPhase() noexcept;
     static const char* stateToStr(State state);
 
     State state_{State::CLEARED};
     std::atomic<unsigned int> position_{0};
     std::atomic<unsigned int> numFrames_{0};
 
+    unsigned int latencyFrames_{0};
+    unsigned int beatsPerBar_{DEFAULT_BEATS_PER_BAR};
+
+    // Gain applied to what is recorded, precomputed: ones for most buffers, the fade table
+    // only for the frames of a punch-in or punch-out
+    double fadeSeconds_{DEFAULT_FADE_SECONDS};
+    unsigned int fadeFrames_{0};
+    std::vector<float> fadeIn_;
+    std::vector<float> unityGain_;
+    std::vector<float> writeGains_;
+    unsigned int punchInDone_{0};
+    unsigned int punchOutRemaining_{0};
+    bool punchingOut_{false};
+    // where stop was pressed during the first pass, its punch-out fade is recorded past it
+    unsigned int firstPassStop_{0};
+    // First pass frames recorded while a stretch session winding down still read the loop,
+    // copied into it once the stretcher is idle
+    std::vector<std::vector<float>> held_;
+    unsigned int heldStart_{0};
+    unsigned int heldFrames_{0};
+
+    TempoSync tempo_;
+    std::atomic<double> bpm_{0.0};
+    std::uint64_t frameTime_{0};
+    std::uint64_t recordStartFrame_{0};
+    // audio thread's minor fault count when the first pass started, and what it took during
+    // the pass once it is done, -1 after it was reported
+    long firstPassFaultsStart_{0};
+    std::atomic<long> firstPassFaults_{-1};
+    std::atomic<bool> recordRefused_{false};
+    double loopTicks_{0.0};
+    double anchorTick_{0.0};
+
     unsigned int numChannels_{0};
     unsigned int maxFrames_{0};
-    std::vector<std::vector<float>> buffers_;
+    LoopBuffer buffers_;
+    WaveformOverview overview_;
+    LayerHistory history_;
+    std::vector<bool> overviewDirty_;
+    unsigned int numOverviewDirty_{0};
+    unsigned int overviewCursor_{0};
+
+    // after buffers_, the worker reads them until it is destroyed
+    TimeStretcher stretcher_;
+    StretchState stretchState_{StretchState::OFF};
+    double loopBpm_{0.0};
+    unsigned int stretchRemaining_{0};
+    // speed factor the clock phase lock applies on top of the tempo ratio
+    double stretchCorrection_{1.0};
+
+    std::atomic<double> speed_{1.0};
+    Interpolation interpolation_{Interpolation::CUBIC};
+    // fractional playhead, position_ is its integer part while the loop plays at another speed
+    double playhead_{0.0};
+    std::vector<float> varispeedSource_;
+
+    unsigned int sampleRate_{0};
+    std::vector<float*> segment_;
+
+    // after buffers_ and overview_, the worker writes them until it is destroyed
+    LoopResampler resampler_;
+    bool resampling_{false};
+    unsigned int detachedFrames_{0};
 
     LooperMailbox commandMailbox_{128};
+    LooperMailbox midiMailbox_{128};
+
+    std::array<ScheduledCommand, 256> scheduled_;
+    unsigned int numScheduled_{0};
 };
 
 }
@@ -6,6 +6,15 @@ namespace looper {
 LooperCommand LooperCommand::startRecording() noexcept{ return LooperCommand{ StartRecording{} }; }
 LooperCommand LooperCommand::stopRecording() noexcept { return LooperCommand{ StopRecording{} }; }
 LooperCommand LooperCommand::clear() noexcept { return LooperCommand{ Clear{} }; }
+LooperCommand LooperCommand::undo() noexcept { return LooperCommand{ Undo{} }; }
+LooperCommand LooperCommand::redo() noexcept { return LooperCommand{ Redo{} }; }
+LooperCommand LooperCommand::setSpeed(double ratio) noexcept { return LooperCommand{ SetSpeed{ ratio } }; }
+LooperCommand LooperCommand::toggleReverse() noexcept { return LooperCommand{ ToggleReverse{} }; }
+LooperCommand LooperCommand::setInterpolation(Interpolation mode) noexcept { return LooperCommand{ SetInterpolation{ mode } }; }
+LooperCommand LooperCommand::clockTick() noexcept { return LooperCommand{ ClockTick{} }; }
+LooperCommand LooperCommand::clockStart() noexcept { return LooperCommand{ ClockStart{} }; }
+LooperCommand LooperCommand::clockStop() noexcept { return LooperCommand{ ClockStop{} }; }
+LooperCommand LooperCommand::setTempo(double bpm) noexcept { return LooperCommand{ SetTempo{ bpm } }; }
 
 void LooperCommand::apply(Looper& looper) const
 {
@@ -15,5 +24,14 @@ void LooperCommand::apply(Looper& looper) const
 void LooperCommand::StartRecording::apply(Looper& looper) const { looper.startRecording(); }
 void LooperCommand::StopRecording::apply(Looper& looper) const { looper.stopRecording(); }
 void LooperCommand::Clear::apply(Looper& looper) const { looper.clear(); }
+void LooperCommand::Undo::apply(Looper& looper) const { looper.undo(); }
+void LooperCommand::Redo::apply(Looper& looper) const { looper.redo(); }
+void LooperCommand::SetSpeed::apply(Looper& looper) const { looper.setSpeed(ratio); }
+void LooperCommand::ToggleReverse::apply(Looper& looper) const { looper.toggleReverse(); }
+void LooperCommand::SetInterpolation::apply(Looper& looper) const { looper.setInterpolation(mode); }
+void LooperCommand::ClockTick::apply(Looper& looper) const { looper.clockTick(); }
+void LooperCommand::ClockStart::apply(Looper& looper) const { looper.clockStart(); }
+void LooperCommand::ClockStop::apply(Looper& looper) const { looper.clockStop(); }
+void LooperCommand::SetTempo::apply(Looper& looper) const { looper.setTempo(bpm); }
 
 } // namespace looper
@@ -2,7 +2,9 @@
 
 #include <variant>
 
+#include "interpolation.h"
 #include "spsc_mailbox.h"
+#include "timestamp.h"
 
 namespace looper {
 
@@ -16,9 +18,26 @@ public:
     static LooperCommand startRecording() noexcept;
     static LooperCommand stopRecording() noexcept;
     static LooperCommand clear() noexcept;
+    static LooperCommand undo() noexcept;
+    static LooperCommand redo() noexcept;
+
+    // Varispeed, a negative ratio plays backwards
+    static LooperCommand setSpeed(double ratio) noexcept;
+    static LooperCommand toggleReverse() noexcept;
+    static LooperCommand setInterpolation(Interpolation mode) noexcept;
+
+    // MIDI clock (24 ppqn) and host tempo
+    static LooperCommand clockTick() noexcept;
+    static LooperCommand clockStart() noexcept;
+    static LooperCommand clockStop() noexcept;
+    static LooperCommand setTempo(double bpm) noexcept;
 
     void apply(Looper& looper) const;
 
+    // Capture time of the event that caused the command, 0 applies it at the start of the next buffer
+    LooperCommand& at(Timestamp time) noexcept { time_ = time; return *this; }
+    Timestamp getTimestamp() const noexcept { return time_; }
+
 private:
     struct Dummy
     {
@@ -40,16 +59,74 @@ private:
         void apply(Looper& looper) const;
     };
 
+    struct Undo
+    {
+        void apply(Looper& looper) const;
+    };
+
+    struct Redo
+    {
+        void apply(Looper& looper) const;
+    };
+
+    struct SetSpeed
+    {
+        double ratio;
+        void apply(Looper& looper) const;
+    };
+
+    struct ToggleReverse
+    {
+        void apply(Looper& looper) const;
+    };
+
+    struct SetInterpolation
+    {
+        Interpolation mode;
+        void apply(Looper& looper) const;
+    };
+
+    struct ClockTick
+    {
+        void apply(Looper& looper) const;
+    };
+
+    struct ClockStart
+    {
+        void apply(Looper& looper) const;
+    };
+
+    struct ClockStop
+    {
+        void apply(Looper& looper) const;
+    };
+
+    struct SetTempo
+    {
+        double bpm;
+        void apply(Looper& looper) const;
+    };
+
     using Variant = std::variant<
         Dummy,
         StartRecording,
         StopRecording,
-        Clear
+        Clear,
+        Undo,
+        Redo,
+        SetSpeed,
+        ToggleReverse,
+        SetInterpolation,
+        ClockTick,
+        ClockStart,
+        ClockStop,
+        SetTempo
     >;
 
     explicit LooperCommand(Variant cmd) noexcept : cmd_(cmd) {}
 
     Variant cmd_;
+    Timestamp time_{0};
 };
 
 using LooperMailbox = SpscMailbox<LooperCommand>;
@@ -0,0 +1,147 @@
+#include "tempo_sync.h"
+
+#include <cmath>
+#include <numbers>
+
+using namespace looper;
+
+// Loop bandwidth per tick, wide while acquiring the tempo and narrow once locked
+static constexpr double ACQUIRE_BANDWIDTH = 0.05;
+static constexpr double LOCKED_BANDWIDTH = 0.005;
+static constexpr std::uint64_t ACQUIRE_TICKS = 4 * TempoSync::TICKS_PER_BEAT;
+// An interval this close to a whole number of locked periods follows ticks that were dropped
+// on the way (MIDI buffer overflow, USB hiccup), up to this many of them in a row
+static constexpr double MISSED_TICK_TOLERANCE = 0.25;
+static constexpr double MAX_MISSED_TICKS = 4.0;
+
+void TempoSync::reset(unsigned int sampleRate) noexcept
+{
+    sampleRate_ = sampleRate;
+    clockRunning_ = false;
+    tickCount_ = 0;
+    ticksSinceLock_ = 0;
+    lastTickFrame_ = -1.0;
+    period_ = 0.0;
+}
+
+void TempoSync::setHostTempo(double bpm) noexcept
+{
+    hostFramesPerBeat_ = bpm > 0.0 ? 60.0 * sampleRate_ / bpm : 0.0;
+}
+
+void TempoSync::clockStart() noexcept
+{
+    clockRunning_ = true;
+    tickCount_ = 0;
+    ticksSinceLock_ = 0;
+    lastTickFrame_ = -1.0;
+    period_ = 0.0;
+}
+
+void TempoSync::clockStop() noexcept
+{
+    // keeps the last estimate so loops recorded afterwards still snap
+    clockRunning_ = false;
+}
+
+void TempoSync::restartLoop(double frame, double period) noexcept
+{
+    t0_ = frame;
+    period_ = period;
+    t1_ = frame + period;
+    ticksSinceLock_ = 0;
+}
+
+void TempoSync::tick(std::uint64_t frame) noexcept
+{
+    // clock without a start message, e.g. after connecting mid song
+    clockRunning_ = true;
+
+    const auto f = static_cast<double>(frame);
+    ++tickCount_;
+
+    if (lastTickFrame_ < 0.0) {
+        lastTickFrame_ = f;
+        return;
+    }
+
+    if (period_ <= 0.0) {
+        restartLoop(f, f - lastTickFrame_);
+        lastTickFrame_ = f;
+        return;
+    }
+
+    const auto interval = f - lastTickFrame_;
+    lastTickFrame_ = f;
+
+    // dropped ticks are counted and predicted over instead of taken for a slower tempo, once
+    // the period can be trusted
+    if (isClockLocked()) {
+        const auto periods = std::round(interval / period_);
+        if (periods >= 2.0 && periods <= MAX_MISSED_TICKS + 1.0
+            && std::abs(interval - periods * period_) <= MISSED_TICK_TOLERANCE * period_) {
+            tickCount_ += static_cast<std::uint64_t>(periods) - 1;
+            t1_ += (periods - 1.0) * period_;
+        }
+    }
+
+    const auto error = f - t1_;
+
+    // a jump of more than half a tick is a tempo change, start over from the latest interval
+    if (std::abs(error) > 0.5 * period_) {
+        restartLoop(f, interval);
+        return;
+    }
+
+    const auto bandwidth = ticksSinceLock_ < ACQUIRE_TICKS ? ACQUIRE_BANDWIDTH : LOCKED_BANDWIDTH;
+    const auto omega = 2.0 * std::numbers::pi * bandwidth;
+    const auto b = std::numbers::sqrt2 * omega;
+    const auto c = omega * omega;
+
+    t0_ = t1_;
+    t1_ += b * error + period_;
+    period_ += c * error;
+    ++ticksSinceLock_;
+}
+
+bool TempoSync::hasTempo() const noexcept
+{
+    return isClockLocked() || hostFramesPerBeat_ > 0.0;
+}
+
+bool TempoSync::isClockRunning() const noexcept
+{
+    return clockRunning_;
+}
+
+bool TempoSync::isClockLocked() const noexcept
+{
+    return period_ > 0.0 && ticksSinceLock_ >= TICKS_PER_BEAT;
+}
+
+double TempoSync::getFramesPerBeat() const noexcept
+{
+    if (isClockLocked())
+        return period_ * TICKS_PER_BEAT;
+    return hostFramesPerBeat_;
+}
+
+double TempoSync::getBpm() const noexcept
+{
+    const auto framesPerBeat = getFramesPerBeat();
+    return framesPerBeat > 0.0 ? 60.0 * sampleRate_ / framesPerBeat : 0.0;
+}
+
+double TempoSync::getTickPosition(std::uint64_t frame) const noexcept
+{
+    if (period_ <= 0.0)
+        return static_cast<double>(tickCount_);
+
+    // t0_ is the filtered time of the latest tick
+    return static_cast<double>(tickCount_) + (static_cast<double>(frame) - t0_) / period_;
+}
+
+std::uint64_t TempoSync::getTickCount() const noexcept
+{
+    return tickCount_;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+namespace looper {
+
+// Tempo from a host value or from MIDI clock (24 ticks per beat).
+// Clock ticks go through a second order delay-locked loop, so the estimated tick period
+// follows slow tempo changes while the timing jitter of individual ticks is averaged out.
+// Once locked, an interval of a whole number of periods is taken as following dropped ticks,
+// which are counted, so positions stay on the beat and the period is not thrown off.
+// Every call is a handful of arithmetic operations, it runs in the audio callback.
+class TempoSync
+{
+public:
+    static constexpr unsigned int TICKS_PER_BEAT = 24;
+
+    void reset(unsigned int sampleRate) noexcept;
+
+    // bpm <= 0 disables the host tempo
+    void setHostTempo(double bpm) noexcept;
+
+    void clockStart() noexcept;
+    void clockStop() noexcept;
+    void tick(std::uint64_t frame) noexcept;
+
+    bool hasTempo() const noexcept;
+    bool isClockRunning() const noexcept;
+    bool isClockLocked() const noexcept;
+
+    double getFramesPerBeat() const noexcept;
+    double getBpm() const noexcept;
+
+    // Ticks counted since clock start, extrapolated with the filtered period
+    double getTickPosition(std::uint64_t frame) const noexcept;
+    std::uint64_t getTickCount() const noexcept;
+
+private:
+    void restartLoop(double frame, double period) noexcept;
+
+    unsigned int sampleRate_{48000};
+    double hostFramesPerBeat_{0.0};
+
+    bool clockRunning_{false};
+    std::uint64_t tickCount_{0};
+    std::uint64_t ticksSinceLock_{0};
+    double lastTickFrame_{-1.0};
+
+    // loop state: predicted time of the current and next tick, filtered period
+    double t0_{0.0};
+    double t1_{0.0};
+    double period_{0.0};
+};
+
+} // namespace looper
@@ -0,0 +1,261 @@
+#include "time_stretch.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+
+using namespace looper;
+
+// The worker polls this often for requests and ring space, well below the ring's fill time.
+// It never waits on the mailbox, start() then never has to wake it through the kernel.
+static constexpr auto POLL_INTERVAL = std::chrono::milliseconds(2);
+// Correlation is evaluated on every n-th frame, plenty to find the waveform alignment
+static constexpr unsigned int CORRELATION_STRIDE = 4;
+
+TimeStretcher::TimeStretcher()
+{
+    // periodic Hann, overlapping halves sum to exactly one
+    window_.resize(WINDOW_FRAMES);
+    for (auto i{0u}; i < WINDOW_FRAMES; ++i)
+        window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * i / WINDOW_FRAMES));
+
+    target_.resize(HOP_FRAMES);
+    candidates_.resize(HOP_FRAMES + 2 * SEARCH_FRAMES);
+
+    worker_ = std::thread([this] { workerLoop(); });
+}
+
+TimeStretcher::~TimeStretcher()
+{
+    active_.store(0, std::memory_order_seq_cst);
+    quit_.store(true, std::memory_order_release);
+    worker_.join();
+}
+
+void TimeStretcher::prepare(const LoopBuffer* source, unsigned int numChannels, unsigned int sampleRate,
+                            unsigned int maxFrames)
+{
+    stop();
+    waitIdle();
+
+    // nothing renders until the next start(), the worker does not touch its state
+    source_ = source;
+    numChannels_ = numChannels;
+
+    // keep a couple of callbacks worth of audio ahead of the reader, plus the reserve
+    const auto blockFrames = std::max(maxFrames, sampleRate / 50);
+    targetFill_ = std::max(4 * HOP_FRAMES, (2 * blockFrames + RESERVE_FRAMES + HOP_FRAMES - 1) / HOP_FRAMES * HOP_FRAMES);
+    const auto capacity = std::bit_ceil(targetFill_ + HOP_FRAMES);
+    ringMask_ = capacity - 1;
+
+    ring_.assign(numChannels_, std::vector<float>(capacity, 0.0f));
+    hopPositions_ = std::vector<std::atomic<double>>(capacity / HOP_FRAMES);
+    overlap_.assign(numChannels_, std::vector<float>(HOP_FRAMES, 0.0f));
+    writeIndex_.store(0, std::memory_order_relaxed);
+    readIndex_.store(0, std::memory_order_relaxed);
+}
+
+bool TimeStretcher::start(unsigned int position, unsigned int numFrames, double speed) noexcept
+{
+    if (numFrames < WINDOW_FRAMES || ring_.empty() || !isIdle())
+        return false;
+
+    // the worker is outside a hop and cannot enter one for the old session anymore
+    readIndex_.store(writeIndex_.load(std::memory_order_acquire), std::memory_order_release);
+    speed_.store(speed, std::memory_order_relaxed);
+    readerLoopFrames_ = numFrames;
+
+    const auto session = ++nextSession_ == 0 ? ++nextSession_ : nextSession_;
+    active_.store(session, std::memory_order_seq_cst);
+
+    if (!requests_.tryPush(Request{session, position, numFrames})) {
+        active_.store(0, std::memory_order_seq_cst);
+        return false;
+    }
+    return true;
+}
+
+void TimeStretcher::setSpeed(double speed) noexcept
+{
+    speed_.store(speed, std::memory_order_relaxed);
+}
+
+void TimeStretcher::stop() noexcept
+{
+    active_.store(0, std::memory_order_seq_cst);
+}
+
+bool TimeStretcher::isIdle() const noexcept
+{
+    return active_.load(std::memory_order_seq_cst) == 0 && !busy_.load(std::memory_order_seq_cst);
+}
+
+unsigned int TimeStretcher::available() const noexcept
+{
+    const auto written = writeIndex_.load(std::memory_order_acquire);
+    return static_cast<unsigned int>(written - readIndex_.load(std::memory_order_relaxed));
+}
+
+bool TimeStretcher::mix(float *const *data, unsigned int offset, unsigned int nFrames, float fromGain, float toGain) noexcept
+{
+    if (available() < nFrames) return false;
+
+    const auto read = readIndex_.load(std::memory_order_relaxed);
+    const auto gainStep = nFrames > 0 ? (toGain - fromGain) / static_cast<float>(nFrames) : 0.0f;
+
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        const auto& ring = ring_[ch];
+        auto gain = fromGain;
+        for (auto i{0u}; i < nFrames; ++i) {
+            data[ch][offset + i] += gain * ring[(read + i) & ringMask_];
+            gain += gainStep;
+        }
+    }
+
+    readIndex_.store(read + nFrames, std::memory_order_release);
+    return true;
+}
+
+double TimeStretcher::getSourcePosition() const noexcept
+{
+    if (readerLoopFrames_ == 0) return 0.0;
+
+    const auto read = readIndex_.load(std::memory_order_relaxed);
+    const auto hop = (read & ringMask_) / HOP_FRAMES;
+    const auto offset = static_cast<double>(read % HOP_FRAMES);
+
+    const auto position = hopPositions_[hop].load(std::memory_order_relaxed) + offset * speed_.load(std::memory_order_relaxed);
+    return std::fmod(position, static_cast<double>(readerLoopFrames_));
+}
+
+void TimeStretcher::workerLoop()
+{
+    while (!quit_.load(std::memory_order_acquire)) {
+        Request request;
+        if (requests_.tryPop(request)) {
+            // only the latest request matters
+            while (requests_.tryPop(request)) {}
+
+            session_ = request.session;
+            loopFrames_ = request.numFrames;
+            nominal_ = request.position;
+            primed_ = false;
+        }
+
+        renderAhead();
+        std::this_thread::sleep_for(POLL_INTERVAL);
+    }
+}
+
+void TimeStretcher::renderAhead()
+{
+    while (session_ != 0) {
+        // pairs with stop(): either the audio thread sees the hop in progress or we see the stop,
+        // shared state is only touched in between
+        busy_.store(true, std::memory_order_seq_cst);
+        if (active_.load(std::memory_order_seq_cst) != session_) {
+            busy_.store(false, std::memory_order_seq_cst);
+            session_ = 0;
+            return;
+        }
+
+        const auto fill = writeIndex_.load(std::memory_order_relaxed) - readIndex_.load(std::memory_order_acquire);
+        if (fill + HOP_FRAMES > targetFill_) {
+            busy_.store(false, std::memory_order_seq_cst);
+            return;
+        }
+
+        if (!primed_) prime();
+        renderHop();
+
+        busy_.store(false, std::memory_order_seq_cst);
+    }
+}
+
+void TimeStretcher::prime()
+{
+    // start as if the previous grain ended right before the start position, so the first
+    // output frames are the loop itself rather than a fade in
+    previous_ = static_cast<long long>(nominal_) - HOP_FRAMES;
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        for (auto i{0u}; i < HOP_FRAMES; ++i)
+            overlap_[ch][i] = window_[HOP_FRAMES + i] * sourceAt(ch, previous_ + HOP_FRAMES + i);
+    }
+    primed_ = true;
+}
+
+void TimeStretcher::renderHop()
+{
+    const auto nominal = static_cast<long long>(std::floor(nominal_));
+    const auto start = nominal + findBestOffset(nominal);
+
+    const auto write = writeIndex_.load(std::memory_order_relaxed);
+    hopPositions_[(write & ringMask_) / HOP_FRAMES].store(nominal_, std::memory_order_relaxed);
+
+    for (auto ch{0u}; ch < numChannels_; ++ch) {
+        auto& ring = ring_[ch];
+        auto& overlap = overlap_[ch];
+        for (auto i{0u}; i < HOP_FRAMES; ++i) {
+            ring[(write + i) & ringMask_] = overlap[i] + window_[i] * sourceAt(ch, start + i);
+            overlap[i] = window_[HOP_FRAMES + i] * sourceAt(ch, start + HOP_FRAMES + i);
+        }
+    }
+
+    writeIndex_.store(write + HOP_FRAMES, std::memory_order_release);
+
+    previous_ = start;
+    nominal_ = std::fmod(nominal_ + HOP_FRAMES * speed_.load(std::memory_order_relaxed), static_cast<double>(loopFrames_));
+}
+
+long long TimeStretcher::findBestOffset(long long nominal) noexcept
+{
+    // the grain that best continues the waveform of the previous one, i.e. whose first half
+    // correlates most with what followed the previous grain in the loop
+    for (auto i{0u}; i < HOP_FRAMES; i += CORRELATION_STRIDE) {
+        auto sum = 0.0f;
+        for (auto ch{0u}; ch < numChannels_; ++ch)
+            sum += sourceAt(ch, previous_ + HOP_FRAMES + i);
+        target_[i] = sum;
+    }
+
+    const auto first = nominal - static_cast<long long>(SEARCH_FRAMES);
+    for (auto i{0u}; i < candidates_.size(); ++i) {
+        auto sum = 0.0f;
+        for (auto ch{0u}; ch < numChannels_; ++ch)
+            sum += sourceAt(ch, first + i);
+        candidates_[i] = sum;
+    }
+
+    auto best = 0.0f;
+    auto bestOffset = 0u;
+    for (auto offset{0u}; offset <= 2 * SEARCH_FRAMES; ++offset) {
+        auto correlation = 0.0f;
+        for (auto i{0u}; i < HOP_FRAMES; i += CORRELATION_STRIDE)
+            correlation += target_[i] * candidates_[offset + i];
+
+        if (correlation > best) {
+            best = correlation;
+            bestOffset = offset;
+        }
+    }
+
+    // silence or no similarity at all, stay on the nominal position
+    if (best <= 0.0f) return 0;
+    return static_cast<long long>(bestOffset) - SEARCH_FRAMES;
+}
+
+float TimeStretcher::sourceAt(unsigned int channel, long long frame) const noexcept
+{
+    const auto length = static_cast<long long>(loopFrames_);
+    auto index = frame % length;
+    if (index < 0) index += length;
+    return source_->at(channel, static_cast<unsigned int>(index));
+}
+
+void TimeStretcher::waitIdle() const noexcept
+{
+    while (busy_.load(std::memory_order_seq_cst))
+        std::this_thread::yield();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "loop_buffer.h"
+#include "spsc_mailbox.h"
+
+namespace looper {
+
+// WSOLA time-stretcher reading a circular loop at a variable speed without changing its pitch.
+// A worker thread renders ahead into a ring, the audio thread only mixes frames out of it.
+//
+// The worker reads the loop buffers while a session is active, so the owner must not write
+// them between start() and the moment isIdle() reports true after stop().
+class TimeStretcher
+{
+public:
+    // Analysis window and overlap, sized for 44.1/48 kHz (~21 ms grains, ±5 ms search)
+    static constexpr unsigned int WINDOW_FRAMES = 1024;
+    static constexpr unsigned int HOP_FRAMES = WINDOW_FRAMES / 2;
+    static constexpr unsigned int SEARCH_FRAMES = 256;
+    // Rendered on top of what the reader needs per callback, so a reader that sees less than
+    // a callback plus this much ahead can still fade out over this many frames
+    static constexpr unsigned int RESERVE_FRAMES = HOP_FRAMES;
+
+    TimeStretcher();
+    ~TimeStretcher();
+
+    TimeStretcher(const TimeStretcher&) = delete;
+    TimeStretcher& operator=(const TimeStretcher&) = delete;
+
+    // Not real-time safe, the stream must be stopped. Ends the current session and waits for
+    // the worker to let go of the source.
+    void prepare(const LoopBuffer* source, unsigned int numChannels, unsigned int sampleRate,
+                 unsigned int maxFrames);
+
+    // -- Audio thread --
+    // Renders the loop [0, numFrames) from position on, fails while the last session is still
+    // winding down
+    bool start(unsigned int position, unsigned int numFrames, double speed) noexcept;
+    void setSpeed(double speed) noexcept;
+    void stop() noexcept;
+    bool isIdle() const noexcept;
+    // Spins until the worker is out of the hop it may be in, after stop() that is at most one
+    // hop of work
+    void waitIdle() const noexcept;
+
+    unsigned int available() const noexcept;
+
+    // Adds nFrames to data from offset on with a gain ramp, fails without consuming anything
+    // on underrun
+    bool mix(float *const *data, unsigned int offset, unsigned int nFrames, float fromGain, float toGain) noexcept;
+
+    // Loop position of the next frame mix() returns
+    double getSourcePosition() const noexcept;
+
+private:
+    struct Request
+    {
+        std::uint32_t session{0};
+        unsigned int position{0};
+        unsigned int numFrames{0};
+    };
+
+    void workerLoop();
+    void renderAhead();
+    void prime();
+    void renderHop();
+    long long findBestOffset(long long nominal) noexcept;
+    float sourceAt(unsigned int channel, long long frame) const noexcept;
+
+    std::thread worker_;
+    std::atomic<bool> quit_{false};
+
+    // audio thread -> worker
+    SpscMailbox<Request> requests_{8};
+    std::atomic<std::uint32_t> active_{0};
+    std::atomic<bool> busy_{false};
+    std::atomic<double> speed_{1.0};
+    std::uint32_t nextSession_{0};
+    unsigned int readerLoopFrames_{0};
+
+    // ring, written by the worker and read by the audio thread
+    std::vector<std::vector<float>> ring_;
+    std::vector<std::atomic<double>> hopPositions_;
+    unsigned int ringMask_{0};
+    unsigned int targetFill_{0};
+    std::atomic<std::uint64_t> writeIndex_{0};
+    std::atomic<std::uint64_t> readIndex_{0};
+
+    // worker state
+    const LoopBuffer* source_{nullptr};
+    unsigned int numChannels_{0};
+    std::uint32_t session_{0};
+    bool primed_{false};
+    unsigned int loopFrames_{0};
+    double nominal_{0.0};
+    long long previous_{0};
+    std::vector<float> window_;
+    std::vector<std::vector<float>> overlap_;
+    std::vector<float> target_;
+    std::vector<float> candidates_;
+};
+
+} // namespace looper
@@ -0,0 +1,160 @@
+#include "waveform_overview.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace looper;
+
+// A read overlapping updates this many times gives up until the next frame
+static constexpr unsigned int MAX_READ_ATTEMPTS = 8;
+
+void WaveformOverview::prepare(unsigned int maxFrames)
+{
+    maxFrames_ = maxFrames;
+    levels_.clear();
+
+    auto binFrames = BASE_BIN_FRAMES;
+    auto size = std::max(1u, (maxFrames + BASE_BIN_FRAMES - 1) / BASE_BIN_FRAMES);
+    while (true) {
+        levels_.push_back(Level{std::make_unique<AtomicBin[]>(size), size, binFrames});
+        if (size == 1) break;
+
+        size = (size + LEVEL_FACTOR - 1) / LEVEL_FACTOR;
+        binFrames *= LEVEL_FACTOR;
+    }
+
+    version_.store(0, std::memory_order_relaxed);
+}
+
+void WaveformOverview::update(const LoopBuffer& buffers, unsigned int first, unsigned int count) noexcept
+{
+    if (count == 0 || levels_.empty() || first >= maxFrames_) return;
+
+    auto firstBin = first / BASE_BIN_FRAMES;
+    auto lastBin = (std::min(first + count, maxFrames_) - 1) / BASE_BIN_FRAMES;
+
+    const auto version = version_.load(std::memory_order_relaxed);
+    version_.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto& base = levels_.front();
+    for (auto b{firstBin}; b <= lastBin; ++b) {
+        const auto begin = b * BASE_BIN_FRAMES;
+        const auto end = std::min(begin + BASE_BIN_FRAMES, maxFrames_);
+
+        auto lo = 0.0f;
+        auto hi = 0.0f;
+        auto sumSquares = 0.0f;
+        for (auto ch{0u}; ch < buffers.getNumChannels(); ++ch) {
+            for (auto i{begin}; i < end; ++i) {
+                const auto sample = buffers.at(ch, i);
+                lo = std::min(lo, sample);
+                hi = std::max(hi, sample);
+                sumSquares += sample * sample;
+            }
+        }
+
+        const auto numSamples = static_cast<float>((end - begin) * std::max(1u, buffers.getNumChannels()));
+        base.bins[b].min.store(lo, std::memory_order_relaxed);
+        base.bins[b].max.store(hi, std::memory_order_relaxed);
+        base.bins[b].meanSquare.store(sumSquares / numSamples, std::memory_order_relaxed);
+    }
+
+    // parents of the touched bins, from their children
+    for (auto l{1u}; l < levels_.size(); ++l) {
+        const auto& children = levels_[l - 1];
+        auto& level = levels_[l];
+        firstBin /= LEVEL_FACTOR;
+        lastBin /= LEVEL_FACTOR;
+
+        for (auto b{firstBin}; b <= lastBin; ++b) {
+            const auto begin = b * LEVEL_FACTOR;
+            const auto end = std::min(begin + LEVEL_FACTOR, children.size);
+
+            auto lo = 0.0f;
+            auto hi = 0.0f;
+            auto meanSquare = 0.0f;
+            for (auto c{begin}; c < end; ++c) {
+                lo = std::min(lo, children.bins[c].min.load(std::memory_order_relaxed));
+                hi = std::max(hi, children.bins[c].max.load(std::memory_order_relaxed));
+                meanSquare += children.bins[c].meanSquare.load(std::memory_order_relaxed);
+            }
+
+            level.bins[b].min.store(lo, std::memory_order_relaxed);
+            level.bins[b].max.store(hi, std::memory_order_relaxed);
+            level.bins[b].meanSquare.store(meanSquare / static_cast<float>(end - begin), std::memory_order_relaxed);
+        }
+    }
+
+    version_.store(version + 2, std::memory_order_release);
+}
+
+void WaveformOverview::clear() noexcept
+{
+    const auto version = version_.load(std::memory_order_relaxed);
+    version_.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (auto& level : levels_) {
+        for (auto b{0u}; b < level.size; ++b) {
+            level.bins[b].min.store(0.0f, std::memory_order_relaxed);
+            level.bins[b].max.store(0.0f, std::memory_order_relaxed);
+            level.bins[b].meanSquare.store(0.0f, std::memory_order_relaxed);
+        }
+    }
+
+    version_.store(version + 2, std::memory_order_release);
+}
+
+bool WaveformOverview::read(unsigned int numFrames, std::vector<Bin>& columns) const noexcept
+{
+    const auto width = static_cast<unsigned int>(columns.size());
+    if (width == 0 || levels_.empty()) return true;
+
+    numFrames = std::min(numFrames, maxFrames_);
+    if (numFrames == 0) {
+        std::ranges::fill(columns, Bin{});
+        return true;
+    }
+
+    // coarsest level with at least one bin per column
+    const auto framesPerColumn = numFrames / width;
+    auto l = 0u;
+    while (l + 1 < levels_.size() && levels_[l + 1].binFrames <= framesPerColumn)
+        ++l;
+
+    const auto& level = levels_[l];
+    const auto numBins = std::min(level.size, (numFrames + level.binFrames - 1) / level.binFrames);
+
+    for (auto attempt{0u}; attempt < MAX_READ_ATTEMPTS; ++attempt) {
+        const auto version = version_.load(std::memory_order_acquire);
+        if (version & 1u) continue;
+
+        for (auto c{0u}; c < width; ++c) {
+            const auto begin = static_cast<unsigned int>(static_cast<std::uint64_t>(c) * numBins / width);
+            const auto end = std::max(begin + 1, static_cast<unsigned int>(static_cast<std::uint64_t>(c + 1) * numBins / width));
+
+            auto lo = 0.0f;
+            auto hi = 0.0f;
+            auto meanSquare = 0.0f;
+            for (auto b{begin}; b < end && b < numBins; ++b) {
+                lo = std::min(lo, level.bins[b].min.load(std::memory_order_relaxed));
+                hi = std::max(hi, level.bins[b].max.load(std::memory_order_relaxed));
+                meanSquare += level.bins[b].meanSquare.load(std::memory_order_relaxed);
+            }
+
+            columns[c] = Bin{lo, hi, std::sqrt(meanSquare / static_cast<float>(end - begin))};
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version_.load(std::memory_order_relaxed) == version)
+            return true;
+    }
+
+    return false;
+}
+
+std::uint32_t WaveformOverview::getVersion() const noexcept
+{
+    return version_.load(std::memory_order_acquire);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "loop_buffer.h"
+
+namespace looper {
+
+// Min/max/RMS pyramid of the loop buffers for drawing the waveform.
+// The audio thread recomputes only the bins it touched, the UI reads any level without locks:
+// bins are relaxed atomics behind a seqlock version, a read that overlaps an update is retried.
+class WaveformOverview
+{
+public:
+    static constexpr unsigned int BASE_BIN_FRAMES = 256;
+    static constexpr unsigned int LEVEL_FACTOR = 4;
+
+    struct Bin
+    {
+        float min{0.0f};
+        float max{0.0f};
+        float rms{0.0f};
+    };
+
+    // Not real-time safe, the stream must be stopped
+    void prepare(unsigned int maxFrames);
+
+    // -- Audio thread --
+    // Recomputes the bins covering frames [first, first + count) of buffers (all channels)
+    void update(const LoopBuffer& buffers, unsigned int first, unsigned int count) noexcept;
+    void clear() noexcept;
+
+    // -- Any thread --
+    // Summarizes frames [0, numFrames) into columns.size() columns, from the coarsest level
+    // that still has at least one bin per column. Fails when it keeps racing the audio thread,
+    // columns are then left in an unspecified state.
+    bool read(unsigned int numFrames, std::vector<Bin>& columns) const noexcept;
+
+    // Changes on every update, lets the UI skip redrawing an unchanged waveform
+    std::uint32_t getVersion() const noexcept;
+
+private:
+    struct AtomicBin
+    {
+        std::atomic<float> min{0.0f};
+        std::atomic<float> max{0.0f};
+        std::atomic<float> meanSquare{0.0f};
+    };
+
+    struct Level
+    {
+        std::unique_ptr<AtomicBin[]> bins;
+        unsigned int size{0};
+        unsigned int binFrames{0};
+    };
+
+    std::vector<Level> levels_;
+    unsigned int maxFrames_{0};
+    std::atomic<std::uint32_t> version_{0};
+};
+
+} // namespace looper
@@ -1,16 +1,101 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <numbers>
 #include <cmath>
+#include <thread>
+#include <vector>
 
 #include "raylib.h"
 
+#include <faust/generated/test.h>
+
 #include "audio/audio_engine.h"
+#include "audio/device_cache.h"
+#include "cli/command_server.h"
+#include "cli/offline_render.h"
+#include "cli/options.h"
+#include "fx/dsp_chain_host.h"
+#include "fx/parameter_table.h"
+#include "fx/spectrum_analyzer.h"
 #include "looper/looper.h"
+#include "midi/midi_input.h"
+#include "timestamp.h"
+
+// Draws the loop waveform from the looper's overview pyramid, columns is one bin per pixel and
+// scratch as large, what a read that raced the audio thread left behind
+static void drawWaveform(const looper::Looper& looper, std::vector<looper::WaveformOverview::Bin>& columns,
+                         std::vector<looper::WaveformOverview::Bin>& scratch, int x, int y, int height)
+{
+    const auto width = static_cast<int>(columns.size());
+    const auto numFrames = looper.getCurrentNumFrames();
+    const auto position = looper.getCurrentPosition();
+
+    // while the first pass is recorded the loop is as long as what was recorded so far
+    const auto length = numFrames > 0 ? numFrames : position;
+
+    DrawRectangleLines(x, y, width, height, LIGHTGRAY);
+    if (length == 0) return;
+
+    // keep the previous frame's columns when the audio thread kept updating during the read,
+    // a failed read leaves a mix of old and new bins
+    if (looper.getOverview().read(length, scratch))
+        columns.swap(scratch);
+
+    const auto middle = y + height / 2;
+    const auto scale = static_cast<float>(height) / 2.0f;
+    for (auto c{0}; c < width; ++c) {
+        const auto& bin = columns[c];
+        DrawLine(x + c, middle - static_cast<int>(std::min(bin.max, 1.0f) * scale),
+                 x + c, middle - static_cast<int>(std::max(bin.min, -1.0f) * scale), GRAY);
+        const auto rms = static_cast<int>(std::min(bin.rms, 1.0f) * scale);
+        DrawLine(x + c, middle - rms, x + c, middle + rms, DARKGRAY);
+    }
+
+    const auto playhead = x + static_cast<int>(static_cast<std::uint64_t>(position) * width / length);
+    DrawLine(playhead, y, playhead, y + height, RED);
+}
+
+// Draws the output spectrum on a log frequency axis, one column per pixel
+static void drawSpectrum(fx::SpectrumAnalyzer& analyzer, int x, int y, int width, int height)
+{
+    constexpr auto minFrequency = 20.0f;
+    constexpr auto floorDb = -90.0f;
+
+    analyzer.update();
+    const auto& magnitudes = analyzer.getMagnitudes();
+    const auto sampleRate = static_cast<float>(analyzer.getSampleRate());
+
+    DrawRectangleLines(x, y, width, height, LIGHTGRAY);
+    if (sampleRate <= 0.0f) return;
+
+    const auto binsPerHz = static_cast<float>(fx::SpectrumAnalyzer::FFT_SIZE) / sampleRate;
+    const auto range = sampleRate / 2.0f / minFrequency;
+    for (auto c{0}; c < width; ++c) {
+        const auto from = minFrequency * std::pow(range, static_cast<float>(c) / width);
+        const auto to = minFrequency * std::pow(range, static_cast<float>(c + 1) / width);
+        const auto first = std::min(static_cast<unsigned int>(from * binsPerHz), fx::SpectrumAnalyzer::NUM_BINS - 1);
+        const auto last = std::clamp(static_cast<unsigned int>(to * binsPerHz), first + 1, fx::SpectrumAnalyzer::NUM_BINS);
+
+        auto db = floorDb;
+        for (auto k{first}; k < last; ++k)
+            db = std::max(db, magnitudes[k]);
+
+        const auto bar = static_cast<int>((db - floorDb) / -floorDb * height);
+        DrawLine(x + c, y + height, x + c, y + height - bar, DARKBLUE);
+    }
+}
 
 class LooperCallback : public audio::AudioCallback
 {
 public:
+    LooperCallback()
+    {
+        effects_.setParameterTable(&parameters_);
+    }
+
     void onProcess(const float *const *in, float *const *out, unsigned int nFrames) override
     {
         const auto& engine = audio::AudioEngine::getInstance();
@@ -25,7 +110,11 @@ public:
             }
         }
 
-        looper_.process(out, nFrames);
+        effects_.process(out, nFrames);
+
+        looper_.setLatencyCompensation(engine.getRoundTripLatency() + effects_.getLatencyFrames());
+        looper_.process(out, nFrames, engine.getCallbackTime());
+        spectrum_.push(out, nFrames);
 
         /*const auto sr = static_cast<float>(engine.getSampleRate());
         constexpr auto twoPi = 2.0f * std::numbers::pi_v<float>;
@@ -44,29 +133,198 @@ public:
     void onStart() override
     {
         //std::cout << "onStart()\n";
+        const auto& engine = audio::AudioEngine::getInstance();
+        effects_.prepare(engine.getNumOutputChannels(), engine.getSampleRate(), audio::AudioEngine::MAX_FRAMES_IN_BUFFER);
         looper_.onStart();
+        spectrum_.prepare(engine.getNumOutputChannels(), engine.getSampleRate(), audio::AudioEngine::MAX_FRAMES_IN_BUFFER);
+        sampleRate_ = engine.getSampleRate();
+    }
+
+    void onSuspend() override
+    {
+        looper_.onSuspend();
+    }
+
+    void onResume() override
+    {
+        // everything is prepared for MAX_FRAMES_IN_BUFFER, only a new sample rate needs more
+        const auto& engine = audio::AudioEngine::getInstance();
+        if (engine.getSampleRate() != sampleRate_) {
+            sampleRate_ = engine.getSampleRate();
+            effects_.prepare(engine.getNumOutputChannels(), sampleRate_, audio::AudioEngine::MAX_FRAMES_IN_BUFFER);
+            spectrum_.prepare(engine.getNumOutputChannels(), sampleRate_, audio::AudioEngine::MAX_FRAMES_IN_BUFFER);
+        }
+        looper_.onResume();
     }
 
     void onStop() override
     {
         //std::cout << "onStop()\n";
         looper_.onStop();
+        spectrum_.stop();
     }
 
     looper::LooperMailbox& getCommandMailbox() { return looper_.getCommandMailbox(); }
+    looper::LooperMailbox& getMidiMailbox() { return looper_.getMidiMailbox(); }
+    fx::ParameterTable& getParameters() { return parameters_; }
+    const looper::Looper& getLooper() const { return looper_; }
+    void reportLooperEvents() { looper_.reportEvents(); }
+    void setFadeTime(double seconds) { looper_.setFadeTime(seconds); }
+    void setBeatsPerBar(unsigned int beats) { looper_.setBeatsPerBar(beats); }
+    fx::SpectrumAnalyzer& getSpectrum() { return spectrum_; }
+
+    // Swaps the input effect chain while the stream keeps running
+    void setEffects(fx::DspChainHost::Builder builder)
+    {
+        const auto crossfade = audio::AudioEngine::getInstance().getSampleRate() / 100;
+        effects_.rebuild(std::move(builder), crossfade);
+    }
 
 private:
+    fx::ParameterTable parameters_;
+    fx::DspChainHost effects_;
     looper::Looper looper_;
+    fx::SpectrumAnalyzer spectrum_;
+    unsigned int sampleRate_{0};
 };
 
-int main()
+// Input is polled this often, frames are only drawn every UI_FRAME_INTERVAL, so a key press
+// reaches the looper within about a millisecond instead of a frame
+static constexpr double INPUT_POLL_INTERVAL = 0.001;
+static constexpr double UI_FRAME_INTERVAL = 1.0 / 60.0;
+
+static void handleKeys(LooperCallback& cb, bool& effectsOn, Timestamp time)
+{
+    auto& mailbox = cb.getCommandMailbox();
+
+    // stamped with the poll time so the looper applies them on the frame they were pressed,
+    // one buffer later
+    if (IsKeyPressed(KEY_R)) {
+        mailbox.tryPush(looper::LooperCommand::startRecording().at(time));
+    } else if (IsKeyPressed(KEY_S)) {
+        mailbox.tryPush(looper::LooperCommand::stopRecording().at(time));
+    } else if (IsKeyPressed(KEY_C)) {
+        mailbox.tryPush(looper::LooperCommand::clear().at(time));
+    } else if (IsKeyPressed(KEY_Z)) {
+        mailbox.tryPush(looper::LooperCommand::undo().at(time));
+    } else if (IsKeyPressed(KEY_Y)) {
+        mailbox.tryPush(looper::LooperCommand::redo().at(time));
+    } else if (IsKeyPressed(KEY_LEFT_BRACKET)) {
+        mailbox.tryPush(looper::LooperCommand::setSpeed(cb.getLooper().getSpeed() * 0.5).at(time));
+    } else if (IsKeyPressed(KEY_RIGHT_BRACKET)) {
+        mailbox.tryPush(looper::LooperCommand::setSpeed(cb.getLooper().getSpeed() * 2.0).at(time));
+    } else if (IsKeyPressed(KEY_BACKSLASH)) {
+        mailbox.tryPush(looper::LooperCommand::toggleReverse().at(time));
+    } else if (IsKeyPressed(KEY_F)) {
+        effectsOn = !effectsOn;
+        if (effectsOn)
+            cb.setEffects([](fx::DspChain& chain) { chain.addStage<mydsp>(); });
+        else
+            cb.setEffects(nullptr);
+    }
+}
+
+static std::atomic<bool> stopRequested{false};
+
+static void runWindow(LooperCallback& cb)
+{
+    SetTraceLogLevel(LOG_ERROR);
+    InitWindow(800, 600, "MainLooper");
+    SetExitKey(KEY_ESCAPE);
+
+    bool effectsOn = false;
+    std::vector<looper::WaveformOverview::Bin> waveform(720);
+    std::vector<looper::WaveformOverview::Bin> waveformScratch(waveform.size());
+    double nextFrame = GetTime();
+
+    while (!WindowShouldClose()) {
+        const auto now = GetTime();
+        if (now >= nextFrame) {
+            nextFrame = std::max(nextFrame + UI_FRAME_INTERVAL, now);
+
+            BeginDrawing();
+            ClearBackground(WHITE);
+
+            DrawText("Quit[Escape] StartRecording[r] StopRecording[s] Clear[c]", 40, 100, 20, BLACK);
+            DrawText(effectsOn ? "Effects[f]: on" : "Effects[f]: off", 40, 130, 20, BLACK);
+            drawWaveform(cb.getLooper(), waveform, waveformScratch, 40, 180, 200);
+            drawSpectrum(cb.getSpectrum(), 40, 400, 720, 180);
+
+            // also polls input
+            EndDrawing();
+        } else {
+            PollInputEvents();
+        }
+
+        handleKeys(cb, effectsOn, timestampNow());
+        cb.reportLooperEvents();
+
+        WaitTime(std::min(INPUT_POLL_INTERVAL, std::max(0.0, nextFrame - GetTime())));
+    }
+
+    CloseWindow();
+}
+
+static void runHeadless(LooperCallback& cb, const cli::Options& options)
 {
+    cli::CommandServer server(cb.getCommandMailbox());
+    if (!server.start(options.stdinCommands, options.socketPath))
+        return;
+
+    std::signal(SIGINT, [](int) { stopRequested.store(true); });
+    std::signal(SIGTERM, [](int) { stopRequested.store(true); });
+
+    std::cout << "Running headless, commands: rec, stop, clear, undo, redo, tempo <bpm>, speed <ratio>, reverse, interp <linear|cubic|sinc>, quit" << std::endl;
+    while (!stopRequested.load() && !server.quitRequested()) {
+        cb.reportLooperEvents();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    server.stop();
+}
+
+int main(int argc, char** argv)
+{
+    cli::Options options;
+    options.deviceCachePath = audio::DeviceCache::getDefaultPath();
+    if (!cli::parseOptions(argc, argv, options) || options.help) {
+        cli::printUsage(argv[0]);
+        return options.help ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     auto& engine = audio::AudioEngine::getInstance();
+    engine.setDeviceCache(options.deviceCachePath, options.rescanDevices);
+
+    if (options.listDevices) {
+        for (const auto& device : engine.getAvailableDevices())
+            device.printInfo();
+        return EXIT_SUCCESS;
+    }
+
     auto cb = std::make_shared<LooperCallback>();
+    cb->setFadeTime(options.fadeMs / 1000.0);
+    cb->setBeatsPerBar(options.beatsPerBar);
+
+    if (!options.renderInput.empty()) {
+        engine.setBufferSize(options.bufferSize);
+        return cli::renderOffline(*cb, cb->getCommandMailbox(), options) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     engine.setAudioCallback(cb);
-    engine.setSampleRate(48000);
-    engine.setBufferSize(64);
-    engine.pickDevices();
+    engine.setSampleRate(options.sampleRate);
+    engine.setBufferSize(options.bufferSize);
+    engine.setRealtimeSettings({options.rtPriority, options.rtCpu, options.lockMemory});
+
+    // nobody is there to answer the prompt in headless mode, it takes the default devices
+    if (options.hasDeviceSelection() || options.headless) {
+        // indices win over names, a missing match falls back to the default device
+        const auto input = options.inputDevice >= 0 ? options.inputDevice
+            : engine.findDevice(options.inputDeviceName, options.hostApi, true);
+        const auto output = options.outputDevice >= 0 ? options.outputDevice
+            : engine.findDevice(options.outputDeviceName, options.hostApi, false);
+        engine.setDevices(input, output);
+    } else
+        engine.pickDevices();
 
     if (!engine.start()) {
         std::cerr << "Failed to start audio engine.\n";
@@ -80,29 +338,16 @@ int main()
 
     std::cout << "Audio engine started\n";
 
-    SetTraceLogLevel(LOG_ERROR);
-    InitWindow(800, 600, "MainLooper");
-    SetTargetFPS(60);
-    SetExitKey(KEY_ESCAPE);
-
-    while (!WindowShouldClose()) {
-        BeginDrawing();
-        ClearBackground(WHITE);
+    midi::MidiInput midiInput(cb->getMidiMailbox(), cb->getParameters());
+    if (!midiInput.start(midi::MidiInput::Mode::HARDWARE))
+        midiInput.start(midi::MidiInput::Mode::VIRTUAL_PORT, "MiniLooper");
 
-        DrawText("Quit[Escape] StartRecording[r] StopRecording[s] Clear[c]", 40, 100, 20, BLACK);
+    if (options.headless)
+        runHeadless(*cb, options);
+    else
+        runWindow(*cb);
 
-        if (IsKeyPressed(KEY_R)) {
-            cb->getCommandMailbox().tryPush(looper::LooperCommand::startRecording());
-        } else if (IsKeyPressed(KEY_S)) {
-            cb->getCommandMailbox().tryPush(looper::LooperCommand::stopRecording());
-        } else if (IsKeyPressed(KEY_C)) {
-            cb->getCommandMailbox().tryPush(looper::LooperCommand::clear());
-        }
-
-        EndDrawing();
-    }
-
-    CloseWindow();
+    midiInput.stop();
 
     if (engine.stop())
         std::cout << "Audio engine stopped successfully.\n";
@@ -0,0 +1,147 @@
+#include "page_memory.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+    #include <unistd.h>
+    #define HAS_MMAP
+#endif
+
+namespace memory {
+
+static constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static std::size_t roundUp(std::size_t size, std::size_t granularity) noexcept
+{
+    return (size + granularity - 1) / granularity * granularity;
+}
+
+std::size_t pageSize() noexcept
+{
+#ifdef HAS_MMAP
+    static const auto size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+void prefault(void* data, std::size_t size) noexcept
+{
+    if (!data) return;
+
+    // a write, so copy-on-write zero pages get their own frame too
+    auto* bytes = static_cast<volatile unsigned char*>(data);
+    for (std::size_t offset = 0; offset < size; offset += pageSize())
+        bytes[offset] = bytes[offset];
+}
+
+bool lockPages(void* data, std::size_t size) noexcept
+{
+#ifdef HAS_MMAP
+    return data && mlock(data, size) == 0;
+#else
+    (void) data;
+    (void) size;
+    return false;
+#endif
+}
+
+long minorFaultCount() noexcept
+{
+#ifdef HAS_MMAP
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_minflt;
+#endif
+    return 0;
+}
+
+long threadMinorFaultCount() noexcept
+{
+#if defined(HAS_MMAP) && defined(RUSAGE_THREAD)
+    rusage usage{};
+    if (getrusage(RUSAGE_THREAD, &usage) == 0)
+        return usage.ru_minflt;
+    return 0;
+#else
+    return minorFaultCount();
+#endif
+}
+
+bool lockProcessMemory()
+{
+#ifdef HAS_MMAP
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "Failed to lock memory: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "Locking memory is not supported on this platform" << std::endl;
+    return false;
+#endif
+}
+
+PageBlock allocatePages(std::size_t size, bool hugePages)
+{
+    PageBlock block;
+    if (size == 0) return block;
+
+#ifdef HAS_MMAP
+    #ifdef MAP_HUGETLB
+    if (hugePages) {
+        const auto hugeSize = roundUp(size, HUGE_PAGE_SIZE);
+        void* ptr = mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            block.data = ptr;
+            block.size = hugeSize;
+            block.hugePages = true;
+            return block;
+        }
+    }
+    #endif
+
+    const auto mapSize = roundUp(size, hugePages ? HUGE_PAGE_SIZE : pageSize());
+    void* ptr = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) return block;
+
+    #ifdef MADV_HUGEPAGE
+    if (hugePages)
+        madvise(ptr, mapSize, MADV_HUGEPAGE);
+    #endif
+
+    block.data = ptr;
+    block.size = mapSize;
+#else
+    (void) hugePages;
+    const auto allocSize = roundUp(size, pageSize());
+    block.data = ::operator new(allocSize, std::align_val_t{4096}, std::nothrow);
+    block.size = block.data ? allocSize : 0;
+    // zeroed like fresh anonymous pages
+    if (block.data)
+        std::memset(block.data, 0, allocSize);
+#endif
+
+    return block;
+}
+
+void freePages(PageBlock& block) noexcept
+{
+    if (!block.data) return;
+
+#ifdef HAS_MMAP
+    munmap(block.data, block.size);
+#else
+    ::operator delete(block.data, std::align_val_t{4096});
+#endif
+
+    block = PageBlock{};
+}
+
+} // namespace memory
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+namespace memory {
+
+// Page granular allocations straight from the OS, optionally backed by huge pages.
+struct PageBlock
+{
+    void* data{nullptr};
+    std::size_t size{0};
+    bool hugePages{false};
+};
+
+// Tries MAP_HUGETLB first when hugePages is set, then regular pages with a transparent
+// huge page hint. The block is zeroed, returns an empty block on failure.
+PageBlock allocatePages(std::size_t size, bool hugePages);
+void freePages(PageBlock& block) noexcept;
+
+std::size_t pageSize() noexcept;
+
+// Touches every page of [data, data + size), so the first real access doesn't fault.
+// Not real-time safe, that is the point of it.
+void prefault(void* data, std::size_t size) noexcept;
+
+// Keeps [data, data + size) in RAM (mlock). Subject to the memlock limit, failures are silent.
+bool lockPages(void* data, std::size_t size) noexcept;
+
+// Minor page faults of the process so far (getrusage), 0 where that isn't available
+long minorFaultCount() noexcept;
+// Minor page faults of the calling thread where the system counts them per thread (Linux),
+// otherwise of the process. One system call, cheap enough for the odd audio thread sample.
+long threadMinorFaultCount() noexcept;
+
+// Locks all current and future pages of the process in RAM (mlockall). Needs CAP_IPC_LOCK or a
+// memlock limit above the process size, failures are reported on stderr.
+bool lockProcessMemory();
+
+} // namespace memory
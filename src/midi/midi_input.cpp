@@ -0,0 +1,199 @@
+#include "midi_input.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <libremidi/libremidi.hpp>
+
+using namespace midi;
+
+MidiInput::MidiInput(looper::LooperMailbox& commands, fx::ParameterTable& parameters)
+    : commands_(commands), parameters_(parameters), mapping_(std::make_unique<MidiMapping>(MidiMapping::makeDefault()))
+{
+}
+
+MidiInput::~MidiInput()
+{
+    stop();
+}
+
+void MidiInput::setMapping(const MidiMapping& mapping)
+{
+    if (isRunning()) {
+        std::cerr << "MIDI mapping can only be changed while stopped" << std::endl;
+        return;
+    }
+
+    *mapping_ = mapping;
+}
+
+std::vector<std::string> MidiInput::getPortNames()
+{
+    std::vector<std::string> names;
+
+    libremidi::observer observer;
+    for (const auto& port : observer.get_input_ports())
+        names.push_back(port.port_name);
+
+    return names;
+}
+
+bool MidiInput::start(Mode mode, const std::string& portName)
+{
+    if (isRunning()) {
+        std::cerr << "MIDI input is already running" << std::endl;
+        return false;
+    }
+
+    if (mode != Mode::LOOPBACK) {
+        libremidi::input_configuration config;
+        config.on_message = [this](const libremidi::message& message) {
+            const auto n = std::min<std::size_t>(message.bytes.size(), 3);
+            RawMessage raw;
+            raw.time = timestampNow();
+            raw.size = static_cast<std::uint8_t>(n);
+            std::copy_n(message.bytes.begin(), n, raw.bytes.begin());
+            incoming_.tryPush(raw);
+        };
+        config.ignore_sysex = true;
+        config.ignore_timing = false;
+        config.ignore_sensing = true;
+
+        try {
+            port_ = std::make_unique<libremidi::midi_in>(config);
+
+            if (mode == Mode::VIRTUAL_PORT) {
+                port_->open_virtual_port(portName.empty() ? "MiniLooper" : portName);
+            } else {
+                libremidi::observer observer;
+                const auto ports = observer.get_input_ports();
+                const auto it = std::ranges::find_if(ports, [&](const auto& port) {
+                    return port.port_name.find(portName) != std::string::npos;
+                });
+                if (it == ports.end()) {
+                    std::cerr << "No MIDI input port matching '" << portName << "'" << std::endl;
+                    port_ = nullptr;
+                    return false;
+                }
+                port_->open_port(*it);
+                std::cout << "MIDI input: " << it->port_name << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error opening MIDI input: " << e.what() << std::endl;
+            port_ = nullptr;
+            return false;
+        }
+
+        if (!port_->is_port_open()) {
+            std::cerr << "Failed to open MIDI input port" << std::endl;
+            port_ = nullptr;
+            return false;
+        }
+    }
+
+    lastControlValue_.fill(0);
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread([this] { threadLoop(); });
+    return true;
+}
+
+void MidiInput::stop()
+{
+    if (!isRunning()) return;
+
+    port_ = nullptr;
+    running_.store(false, std::memory_order_release);
+    thread_.join();
+
+    // drop whatever arrived after the thread exited
+    incoming_.consumeAll([](const RawMessage&) {});
+}
+
+bool MidiInput::isRunning() const noexcept
+{
+    return running_.load(std::memory_order_acquire);
+}
+
+bool MidiInput::inject(const std::uint8_t* bytes, std::size_t size, Timestamp time) noexcept
+{
+    if (!bytes || size == 0) return false;
+
+    RawMessage raw;
+    raw.time = time;
+    raw.size = static_cast<std::uint8_t>(std::min<std::size_t>(size, 3));
+    std::copy_n(bytes, raw.size, raw.bytes.begin());
+    return incoming_.tryPush(raw);
+}
+
+void MidiInput::threadLoop()
+{
+    RawMessage message;
+    while (running_.load(std::memory_order_acquire)) {
+        if (incoming_.waitPop(message, 100'000))
+            handle(message);
+    }
+}
+
+void MidiInput::handle(const RawMessage& message) noexcept
+{
+    if (message.size >= 1 && message.bytes[0] >= 0xF8) {
+        handleRealtime(message);
+        return;
+    }
+
+    if (message.size < 3) return;
+
+    const auto status = message.bytes[0] & 0xF0u;
+    const auto channel = message.bytes[0] & 0x0Fu;
+    const auto key = message.bytes[1] & 0x7Fu;
+    const auto value = message.bytes[2] & 0x7Fu;
+
+    const MidiAction* action = nullptr;
+    bool trigger = false;
+
+    if (status == 0x90 && value > 0) {
+        action = &mapping_->noteAction(channel, key);
+        trigger = true;
+    } else if (status == 0xB0) {
+        action = &mapping_->controlAction(channel, key);
+        auto& last = lastControlValue_[channel * MidiMapping::NUM_KEYS + key];
+        trigger = last < 64 && value >= 64;
+        last = static_cast<std::uint8_t>(value);
+    }
+
+    if (!action) return;
+
+    switch (action->type) {
+        case MidiAction::Type::NONE: {
+            break;
+        }
+        case MidiAction::Type::COMMAND: {
+            if (trigger) {
+                auto command = action->command;
+                if (!commands_.tryPush(command.at(message.time)))
+                    std::cerr << "MIDI command dropped, looper mailbox full" << std::endl;
+            }
+            break;
+        }
+        case MidiAction::Type::PARAMETER: {
+            const auto normalized = static_cast<float>(value) / 127.0f;
+            parameters_.set(action->parameterSlot, action->minValue + normalized * (action->maxValue - action->minValue));
+            break;
+        }
+    }
+}
+
+void MidiInput::handleRealtime(const RawMessage& message) noexcept
+{
+    looper::LooperCommand command;
+    switch (message.bytes[0]) {
+        case 0xF8: command = looper::LooperCommand::clockTick(); break;
+        case 0xFA: // start and continue both restart the tick count, song position is not tracked
+        case 0xFB: command = looper::LooperCommand::clockStart(); break;
+        case 0xFC: command = looper::LooperCommand::clockStop(); break;
+        default: return;
+    }
+
+    if (!commands_.tryPush(command.at(message.time)))
+        std::cerr << "MIDI clock dropped, looper mailbox full" << std::endl;
+}
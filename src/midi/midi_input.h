@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fx/parameter_table.h"
+#include "looper/looper_commands.h"
+#include "spsc_mailbox.h"
+#include "timestamp.h"
+#include "midi_mapping.h"
+
+namespace libremidi {
+    class midi_in;
+}
+
+namespace midi {
+
+// Receives MIDI on a dedicated thread and turns it into timestamped LooperCommands
+// (pushed to the looper's MIDI mailbox) and parameter changes.
+// The backend callback only timestamps and queues the raw bytes, mapping happens on
+// the MIDI thread through a preallocated MidiMapping.
+class MidiInput
+{
+public:
+    enum class Mode
+    {
+        HARDWARE,       // first input port whose name contains the requested name
+        VIRTUAL_PORT,   // a port other applications can connect to (ALSA/CoreMIDI)
+        LOOPBACK,       // no backend, messages only come from inject()
+    };
+
+    MidiInput(looper::LooperMailbox& commands, fx::ParameterTable& parameters);
+    ~MidiInput();
+
+    MidiInput(const MidiInput&) = delete;
+    MidiInput& operator=(const MidiInput&) = delete;
+
+    // Only while stopped
+    void setMapping(const MidiMapping& mapping);
+
+    static std::vector<std::string> getPortNames();
+
+    bool start(Mode mode, const std::string& portName = {});
+    void stop();
+    bool isRunning() const noexcept;
+
+    // Feeds a message as if it came from the port. In LOOPBACK mode this is the only
+    // producer, otherwise it must not be called concurrently with a real port.
+    bool inject(const std::uint8_t* bytes, std::size_t size, Timestamp time = timestampNow()) noexcept;
+
+private:
+    struct RawMessage
+    {
+        std::array<std::uint8_t, 3> bytes{};
+        std::uint8_t size{0};
+        Timestamp time{0};
+    };
+
+    void threadLoop();
+    void handle(const RawMessage& message) noexcept;
+    void handleRealtime(const RawMessage& message) noexcept;
+
+    looper::LooperMailbox& commands_;
+    fx::ParameterTable& parameters_;
+    std::unique_ptr<MidiMapping> mapping_;
+
+    SpscMailbox<RawMessage> incoming_{512};
+    std::unique_ptr<libremidi::midi_in> port_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    std::array<std::uint8_t, MidiMapping::NUM_CHANNELS * MidiMapping::NUM_KEYS> lastControlValue_{};
+};
+
+} // namespace midi
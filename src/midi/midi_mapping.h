@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+
+#include "looper/looper_commands.h"
+
+namespace midi {
+
+struct MidiAction
+{
+    enum class Type
+    {
+        NONE,
+        COMMAND,
+        PARAMETER,
+    };
+
+    Type type{Type::NONE};
+    looper::LooperCommand command;
+    unsigned int parameterSlot{0};
+    float minValue{0.0f};
+    float maxValue{1.0f};
+};
+
+// Lookup from (channel, note) and (channel, controller) to an action. The table is fully
+// preallocated so mapping an incoming message is a single indexed load.
+class MidiMapping
+{
+public:
+    static constexpr unsigned int NUM_CHANNELS = 16;
+    static constexpr unsigned int NUM_KEYS = 128;
+    static constexpr unsigned int ANY_CHANNEL = NUM_CHANNELS;
+
+    // Notes trigger on note-on, controllers trigger commands when crossing 64 upwards
+    void mapNote(unsigned int channel, unsigned int note, const looper::LooperCommand& command) noexcept
+    {
+        MidiAction action;
+        action.type = MidiAction::Type::COMMAND;
+        action.command = command;
+        assign(notes_, channel, note, action);
+    }
+
+    void mapControlToCommand(unsigned int channel, unsigned int controller, const looper::LooperCommand& command) noexcept
+    {
+        MidiAction action;
+        action.type = MidiAction::Type::COMMAND;
+        action.command = command;
+        assign(controls_, channel, controller, action);
+    }
+
+    void mapControlToParameter(unsigned int channel, unsigned int controller, unsigned int slot,
+                               float minValue = 0.0f, float maxValue = 1.0f) noexcept
+    {
+        MidiAction action;
+        action.type = MidiAction::Type::PARAMETER;
+        action.parameterSlot = slot;
+        action.minValue = minValue;
+        action.maxValue = maxValue;
+        assign(controls_, channel, controller, action);
+    }
+
+    const MidiAction& noteAction(unsigned int channel, unsigned int note) const noexcept
+    {
+        return notes_[index(channel, note)];
+    }
+
+    const MidiAction& controlAction(unsigned int channel, unsigned int controller) const noexcept
+    {
+        return controls_[index(channel, controller)];
+    }
+
+    // C4/D4/E4 record/stop/clear, F4/G4 undo/redo, A4 reverse, mod wheel drives parameter 0
+    static MidiMapping makeDefault() noexcept
+    {
+        MidiMapping mapping;
+        mapping.mapNote(ANY_CHANNEL, 60, looper::LooperCommand::startRecording());
+        mapping.mapNote(ANY_CHANNEL, 62, looper::LooperCommand::stopRecording());
+        mapping.mapNote(ANY_CHANNEL, 64, looper::LooperCommand::clear());
+        mapping.mapNote(ANY_CHANNEL, 65, looper::LooperCommand::undo());
+        mapping.mapNote(ANY_CHANNEL, 67, looper::LooperCommand::redo());
+        mapping.mapNote(ANY_CHANNEL, 69, looper::LooperCommand::toggleReverse());
+        mapping.mapControlToParameter(ANY_CHANNEL, 1, 0);
+        return mapping;
+    }
+
+private:
+    using Table = std::array<MidiAction, NUM_CHANNELS * NUM_KEYS>;
+
+    static unsigned int index(unsigned int channel, unsigned int key) noexcept
+    {
+        return (channel % NUM_CHANNELS) * NUM_KEYS + (key % NUM_KEYS);
+    }
+
+    static void assign(Table& table, unsigned int channel, unsigned int key, const MidiAction& action) noexcept
+    {
+        if (channel == ANY_CHANNEL) {
+            for (auto c{0u}; c < NUM_CHANNELS; ++c)
+                table[index(c, key)] = action;
+        } else {
+            table[index(channel, key)] = action;
+        }
+    }
+
+    Table notes_{};
+    Table controls_{};
+};
+
+} // namespace midi
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 #include <readerwritercircularbuffer.h>
 
 template <typename T>
@@ -39,6 +41,12 @@ public:
         return queue_.try_dequeue(out);
     }
 
+    // Blocking consumer, for worker threads only
+    bool waitPop(T& out, std::int64_t timeoutUsecs) noexcept
+    {
+        return queue_.wait_dequeue_timed(out, timeoutUsecs);
+    }
+
     std::size_t approxSize() const noexcept
     {
         return queue_.size_approx();
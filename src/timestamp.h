@@ -0,0 +1,14 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Monotonic time in nanoseconds, shared by input sources and the audio callback so
+// events can be placed at the right frame within a buffer. 0 means "no timestamp".
+using Timestamp = std::int64_t;
+
+inline Timestamp timestampNow() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Latest-value handoff between one producer and one consumer, neither side ever waits.
+// The producer fills the back slot and publishes it, the consumer picks up the most recently
+// published slot; intermediate values are dropped when the consumer is slower.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    TripleBuffer(TripleBuffer const&) = delete;
+    TripleBuffer& operator=(TripleBuffer const&) = delete;
+
+    // Not thread safe, e.g. to preallocate all three slots before use
+    template <typename Fn>
+    void forEach(Fn&& fn)
+    {
+        for (auto& slot : slots_)
+            fn(slot);
+    }
+
+    // Producer
+    T& back() noexcept { return slots_[back_]; }
+
+    void publish() noexcept
+    {
+        const auto previous = middle_.exchange(static_cast<std::uint8_t>(back_ | FRESH), std::memory_order_acq_rel);
+        back_ = previous & INDEX_MASK;
+    }
+
+    // Consumer, returns true when front() changed since the last call
+    bool update() noexcept
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & FRESH))
+            return false;
+
+        const auto previous = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& front() const noexcept { return slots_[front_]; }
+
+private:
+    static constexpr std::uint8_t INDEX_MASK = 0x3;
+    static constexpr std::uint8_t FRESH = 0x4;
+
+    T slots_[3];
+    std::uint8_t back_{0};
+    std::atomic<std::uint8_t> middle_{1};
+    std::uint8_t front_{2};
+};
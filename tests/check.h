@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal assertions for the unit tests, a failed check is printed and fails the test at exit
+inline int failedChecks = 0;
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failedChecks;                                                                 \
+        }                                                                                   \
+    } while (false)
+
+inline int testResult()
+{
+    if (failedChecks > 0)
+        std::fprintf(stderr, "%d checks failed\n", failedChecks);
+    return failedChecks == 0 ? 0 : 1;
+}
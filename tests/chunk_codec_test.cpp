@@ -0,0 +1,77 @@
+// Round trips through the loop chunk codec: error bound, silence, and re-encoding stability
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "check.h"
+#include "looper/chunk_codec.h"
+
+static constexpr unsigned int NUM_FRAMES = 4096;
+
+static std::vector<float> makeNoise(float peak)
+{
+    std::vector<float> block(NUM_FRAMES);
+    unsigned int seed = 1;
+    for (auto& sample : block) {
+        seed = seed * 1664525u + 1013904223u;
+        sample = peak * (static_cast<float>(seed >> 8) / 8388608.0f - 1.0f);
+    }
+    return block;
+}
+
+static std::vector<float> makeSine(float peak)
+{
+    std::vector<float> block(NUM_FRAMES);
+    for (auto i{0u}; i < NUM_FRAMES; ++i)
+        block[i] = peak * static_cast<float>(std::sin(0.01 * i));
+    return block;
+}
+
+// error within 2^-20 of the peak rounded up to a power of two
+static void checkRoundTrip(const std::vector<float>& block)
+{
+    std::vector<std::uint8_t> encoded;
+    looper::encodeChunk(block.data(), NUM_FRAMES, encoded);
+
+    std::vector<float> decoded(NUM_FRAMES);
+    CHECK(looper::decodeChunk(encoded.data(), encoded.size(), decoded.data(), NUM_FRAMES));
+
+    auto peak = 0.0f;
+    auto error = 0.0f;
+    for (auto i{0u}; i < NUM_FRAMES; ++i) {
+        peak = std::max(peak, std::abs(block[i]));
+        error = std::max(error, std::abs(decoded[i] - block[i]));
+    }
+    const auto range = std::exp2(std::ceil(std::log2(peak)));
+    CHECK(error <= range * std::exp2(-20.0f));
+
+    // decoded blocks encode to the same bytes
+    std::vector<std::uint8_t> again;
+    looper::encodeChunk(decoded.data(), NUM_FRAMES, again);
+    CHECK(again == encoded);
+}
+
+int main()
+{
+    checkRoundTrip(makeNoise(1.0f));
+    checkRoundTrip(makeNoise(0.01f));
+    checkRoundTrip(makeSine(0.7f));
+
+    // silence takes one byte and comes back as zeros
+    const std::vector<float> silence(NUM_FRAMES, 0.0f);
+    std::vector<std::uint8_t> encoded;
+    looper::encodeChunk(silence.data(), NUM_FRAMES, encoded);
+    CHECK(encoded.size() == 1);
+    std::vector<float> decoded(NUM_FRAMES, 1.0f);
+    CHECK(looper::decodeChunk(encoded.data(), encoded.size(), decoded.data(), NUM_FRAMES));
+    CHECK(std::all_of(decoded.begin(), decoded.end(), [](float x) { return x == 0.0f; }));
+
+    // truncated data is rejected
+    const auto noise = makeNoise(0.5f);
+    looper::encodeChunk(noise.data(), NUM_FRAMES, encoded);
+    CHECK(!looper::decodeChunk(encoded.data(), encoded.size() / 2, decoded.data(), NUM_FRAMES));
+
+    return testResult();
+}
@@ -0,0 +1,69 @@
+// Varispeed interpolation kernels: exact on the source frames, DC at unity gain, and a tone
+// in the passband reproduced between the frames
+
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+#include "check.h"
+#include "looper/interpolation.h"
+
+static constexpr unsigned int NUM_FRAMES = 4096;
+static constexpr unsigned int NUM_OUT = 1024;
+
+static float maxError(looper::Interpolation mode, const std::vector<float>& source, double position, double step,
+                      double (*expected)(double))
+{
+    std::vector<float> out(NUM_OUT, 0.0f);
+    looper::interpolate(mode, source.data(), position, step, out.data(), NUM_OUT);
+
+    auto error = 0.0;
+    for (auto i{0u}; i < NUM_OUT; ++i)
+        error = std::max(error, std::abs(out[i] - expected(position + i * step)));
+    return static_cast<float>(error);
+}
+
+static double dc(double) { return 0.5; }
+// a tenth of the sample rate
+static double tone(double x) { return std::sin(2.0 * std::numbers::pi * 0.1 * x); }
+
+int main()
+{
+    constexpr looper::Interpolation modes[] = {
+        looper::Interpolation::LINEAR,
+        looper::Interpolation::CUBIC,
+        looper::Interpolation::SINC,
+    };
+    constexpr auto start = static_cast<double>(looper::INTERPOLATION_MARGIN + NUM_OUT);
+
+    const std::vector<float> constant(NUM_FRAMES, 0.5f);
+    std::vector<float> sine(NUM_FRAMES);
+    for (auto i{0u}; i < NUM_FRAMES; ++i)
+        sine[i] = static_cast<float>(tone(i));
+
+    for (const auto mode : modes) {
+        // every step, forwards and backwards, keeps DC
+        for (const auto step : {1.0, 0.5, 0.7937, 1.5, -1.0, -0.5})
+            CHECK(maxError(mode, constant, start + 0.25, step, dc) < 1e-5f);
+
+        // whole positions hit the source frames, the sinc kernel only to its stopband
+        const auto onFrames = maxError(mode, sine, start, 1.0, tone);
+        CHECK(onFrames < (mode == looper::Interpolation::SINC ? 1e-3f : 1e-6f));
+    }
+
+    // between the frames the kernels get better in that order
+    const auto linear = maxError(looper::Interpolation::LINEAR, sine, start + 0.37, 0.7937, tone);
+    const auto cubic = maxError(looper::Interpolation::CUBIC, sine, start + 0.37, 0.7937, tone);
+    const auto sinc = maxError(looper::Interpolation::SINC, sine, start + 0.37, 0.7937, tone);
+    CHECK(linear < 0.05f);
+    CHECK(cubic < linear);
+    CHECK(sinc < cubic);
+    CHECK(sinc < 1e-3f);
+
+    // adds into the output
+    std::vector<float> out(NUM_OUT, 1.0f);
+    looper::interpolate(looper::Interpolation::LINEAR, constant.data(), start, 1.0, out.data(), NUM_OUT);
+    CHECK(out.front() == 1.5f && out.back() == 1.5f);
+
+    return testResult();
+}
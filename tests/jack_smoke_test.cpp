@@ -0,0 +1,112 @@
+// Runs the JACK backend against a private dummy server (jackd -d dummy) for a few periods and
+// checks the callbacks came, in blocks no larger than the period. Skipped when jackd is absent.
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "audio/jack_backend.h"
+
+extern char** environ;
+
+// what CTest's SKIP_RETURN_CODE is set to
+static constexpr int SKIPPED = 77;
+static constexpr unsigned int PERIOD_FRAMES = 256;
+static constexpr unsigned int SAMPLE_RATE = 48000;
+static constexpr auto SERVER_TIMEOUT = std::chrono::seconds(5);
+static constexpr auto RUN_TIME = std::chrono::milliseconds(500);
+
+// its own server name, so a JACK server the user runs is left alone
+static pid_t startServer(const std::string& name)
+{
+    const auto period = std::to_string(PERIOD_FRAMES);
+    const auto rate = std::to_string(SAMPLE_RATE);
+    const char* argv[] = {"jackd", "-n", name.c_str(), "-d", "dummy", "-p", period.c_str(), "-r", rate.c_str(), nullptr};
+
+    pid_t pid = 0;
+    if (posix_spawnp(&pid, "jackd", nullptr, nullptr, const_cast<char* const*>(argv), environ) != 0)
+        return -1;
+    return pid;
+}
+
+static void stopServer(pid_t pid)
+{
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+}
+
+// the server takes a moment to come up
+static std::unique_ptr<audio::JackBackend> connect(audio::AudioBackend::Callback callback)
+{
+    const auto deadline = std::chrono::steady_clock::now() + SERVER_TIMEOUT;
+    while (true) {
+        try {
+            return std::make_unique<audio::JackBackend>(callback);
+        } catch (const std::runtime_error&) {
+            if (std::chrono::steady_clock::now() > deadline)
+                return nullptr;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+}
+
+int main()
+{
+    const auto name = "minilooper_test_" + std::to_string(getpid());
+    const auto server = startServer(name);
+    if (server < 0) {
+        std::printf("jackd not found, skipped\n");
+        return SKIPPED;
+    }
+    setenv("JACK_DEFAULT_SERVER", name.c_str(), 1);
+
+    auto backend = connect([](const float*, float*, unsigned int) { return true; });
+    if (!backend) {
+        std::fprintf(stderr, "Could not connect to the dummy JACK server\n");
+        stopServer(server);
+        return 1;
+    }
+
+    std::atomic<unsigned int> numCallbacks{0};
+    std::atomic<unsigned int> maxFrames{0};
+    backend->setPlanarCallback([&](const float* const* in, float* const* out, unsigned int nFrames) {
+        (void) in;
+        (void) out;
+        numCallbacks.fetch_add(1, std::memory_order_relaxed);
+        if (nFrames > maxFrames.load(std::memory_order_relaxed))
+            maxFrames.store(nFrames, std::memory_order_relaxed);
+        return true;
+    });
+
+    audio::AudioBackend::StreamParams params;
+    CHECK(backend->startStream(0, 0, params));
+    CHECK(params.sampleRate == SAMPLE_RATE);
+    CHECK(params.bufferSize == PERIOD_FRAMES);
+    CHECK(backend->isStreamRunning());
+
+    std::this_thread::sleep_for(RUN_TIME);
+    CHECK(backend->stopStream());
+
+    // half a second is close to a hundred periods, the dummy driver keeps time loosely
+    const auto expected = SAMPLE_RATE / PERIOD_FRAMES / 2;
+    std::printf("%u callbacks, at most %u frames\n", numCallbacks.load(), maxFrames.load());
+    CHECK(numCallbacks.load() >= expected / 4);
+    CHECK(maxFrames.load() <= PERIOD_FRAMES);
+
+    backend = nullptr;
+    stopServer(server);
+
+    return testResult();
+}
@@ -0,0 +1,69 @@
+// looper::LoopBuffer addressing across chunks, contiguous copies, zeroing and chunk swaps
+
+#include "check.h"
+#include "looper/loop_buffer.h"
+
+#include <vector>
+
+using looper::LoopBuffer;
+
+int main()
+{
+    constexpr unsigned int numChannels = 2;
+    constexpr unsigned int numFrames = 3 * LoopBuffer::CHUNK_FRAMES + 100;
+
+    LoopBuffer buffer;
+    CHECK(buffer.allocate(numChannels, numFrames, 2));
+    CHECK(buffer.getNumChannels() == numChannels);
+    CHECK(buffer.getNumFrames() == numFrames);
+    CHECK(buffer.getNumChunks() == 4);
+    CHECK(buffer.getNumFreeChunks() == 2);
+
+    // allocated zeroed
+    auto zeroed = true;
+    for (auto c{0u}; c < numChannels; ++c) {
+        for (auto i{0u}; i < numFrames; ++i)
+            zeroed = zeroed && buffer.at(c, i) == 0.0f;
+    }
+    CHECK(zeroed);
+
+    // a write across a chunk boundary reads back the same, and per frame
+    std::vector<float> in(2 * LoopBuffer::CHUNK_FRAMES);
+    for (auto i{0u}; i < in.size(); ++i)
+        in[i] = static_cast<float>(i + 1);
+    const auto first = LoopBuffer::CHUNK_FRAMES - 10;
+    const auto count = static_cast<unsigned int>(in.size());
+    buffer.write(1, first, count, in.data());
+
+    std::vector<float> out(in.size());
+    buffer.read(1, first, count, out.data());
+    CHECK(out == in);
+    CHECK(buffer.at(1, first) == 1.0f);
+    CHECK(buffer.at(1, LoopBuffer::CHUNK_FRAMES) == 11.0f);
+    CHECK(buffer.at(0, LoopBuffer::CHUNK_FRAMES) == 0.0f);
+
+    buffer.zero(first, 20);
+    CHECK(buffer.at(1, first + 19) == 0.0f);
+    CHECK(buffer.at(1, first + 20) == 21.0f);
+
+    // swapping a spare chunk in replaces that stretch of the loop only
+    auto* spare = buffer.acquireChunk();
+    CHECK(spare != nullptr);
+    CHECK(buffer.getNumFreeChunks() == 1);
+    for (auto i{0u}; i < LoopBuffer::CHUNK_FRAMES; ++i)
+        spare[i] = -1.0f;
+
+    const auto slot = buffer.getSlot(1, 1);
+    auto* old = buffer.exchange(slot, spare);
+    CHECK(buffer.at(1, LoopBuffer::CHUNK_FRAMES) == -1.0f);
+    CHECK(buffer.at(1, 2 * LoopBuffer::CHUNK_FRAMES) == static_cast<float>(LoopBuffer::CHUNK_FRAMES + 11));
+    CHECK(buffer.chunkAt(slot) == spare);
+
+    buffer.releaseChunk(old);
+    CHECK(buffer.getNumFreeChunks() == 2);
+
+    buffer.release();
+    CHECK(buffer.empty());
+
+    return testResult();
+}
@@ -0,0 +1,75 @@
+// DC passes through fx::Resampler at unity gain, streaming and offline, at every quality
+
+#include <cmath>
+#include <vector>
+
+#include "check.h"
+#include "fx/resampler.h"
+
+static constexpr unsigned int NUM_FRAMES = 48000;
+static constexpr float TOLERANCE = 1e-3f;
+
+static void checkStreaming(fx::Resampler::Quality quality, double ratio)
+{
+    fx::Resampler resampler;
+    resampler.prepare(1, ratio, quality);
+
+    const std::vector<float> input(NUM_FRAMES, 0.5f);
+    std::vector<float> output(2 * NUM_FRAMES);
+    const float* in[] = {input.data()};
+    float* out[] = {output.data()};
+
+    unsigned int consumed = 0;
+    const auto written = resampler.process(in, NUM_FRAMES, out, static_cast<unsigned int>(output.size()), consumed);
+    CHECK(consumed > 0);
+    CHECK(written > 0);
+
+    // past the filter's delay and before the end
+    const auto settled = static_cast<unsigned int>(2 * resampler.getNumTaps() * ratio);
+    CHECK(written > 2 * settled);
+    for (auto i = settled; i < written - settled; ++i) {
+        if (std::abs(output[i] - 0.5f) > TOLERANCE) {
+            CHECK(std::abs(output[i] - 0.5f) <= TOLERANCE);
+            break;
+        }
+    }
+}
+
+// circular conversion of a constant loop has no edges to settle from
+static void checkCircular(fx::Resampler::Quality quality, double ratio)
+{
+    fx::Resampler resampler;
+    resampler.prepare(1, ratio, quality);
+
+    const std::vector<float> input(NUM_FRAMES, -0.25f);
+    const auto numOut = static_cast<unsigned int>(NUM_FRAMES * ratio);
+    std::vector<float> output(numOut);
+    resampler.convert(input.data(), NUM_FRAMES, output.data(), 0, numOut, true);
+
+    for (auto i{0u}; i < numOut; ++i) {
+        if (std::abs(output[i] + 0.25f) > TOLERANCE) {
+            CHECK(std::abs(output[i] + 0.25f) <= TOLERANCE);
+            break;
+        }
+    }
+}
+
+int main()
+{
+    constexpr fx::Resampler::Quality qualities[] = {
+        fx::Resampler::Quality::DRAFT,
+        fx::Resampler::Quality::NORMAL,
+        fx::Resampler::Quality::HIGH,
+        fx::Resampler::Quality::BEST,
+    };
+    constexpr double ratios[] = {48000.0 / 44100.0, 44100.0 / 48000.0, 2.0, 0.5};
+
+    for (const auto quality : qualities) {
+        for (const auto ratio : ratios) {
+            checkStreaming(quality, ratio);
+            checkCircular(quality, ratio);
+        }
+    }
+
+    return testResult();
+}